@@ -1,6 +1,7 @@
 #pragma once
 #include "Vector3.h"
 #include "Ray.h"
+#include <cfloat>
 
 class AABB
 {
@@ -18,42 +19,37 @@ public:
 		max = b;
 	}
 
+	//min for 0, max for 1
+	const Vector3& bound(int i) const
+	{
+		return i ? max : min;
+	}
+
 	bool hit(const Ray& r, float tmin, float tmax) const
 	{
-		//Method 1
-		/*
-		for (int a = 0; a < 3; a++)
-		{
-			float t0 = fmin((_min[a] - r.origin[a]) / r.direction[a],
-			                (_max[a] - r.origin[a]) / r.direction[a]);
-			float t1 = fmax((_min[a] - r.origin[a]) / r.direction[a],
-			                (_max[a] - r.origin[a]) / r.direction[a]);
-			tmin = fmax(t0, tmin);
-			tmax = fmin(t1, tmax);
-			if (tmax <= tmin)
-				return false;
-		}
-		return true;
-		*/
+		return hit(PreparedRay(r), tmin, tmax);
+	}
 
-		//Method 2
+	//Conservative slab test. Distances are (bound - origin) * inv_direction, whose relative error
+	//is within gamma(3), so widening the far distance by 2 * gamma(3) keeps boxes the ray grazes.
+	//Comparisons are ordered so a NaN never culls a box.
+	bool hit(const PreparedRay& r, float tmin, float tmax) const
+	{
+		const float unit_roundoff = FLT_EPSILON * 0.5f;
+		const float gamma3 = 3.0f * unit_roundoff / (1.0f - 3.0f * unit_roundoff);
+		const float robust_scale = 1.0f + 2.0f * gamma3;
 		for (int a = 0; a < 3; a++)
 		{
-			float invD = 1.0f / r.direction[a];
-			float t0 = (min[a] - r.origin[a]) * invD;
-			float t1 = (max[a] - r.origin[a]) * invD;
-			if (invD < 0.0f)
-				std::swap(t0, t1);
+			const float t0 = (bound(r.sign[a])[a] - r.origin[a]) * r.inv_direction[a];
+			const float t1 = (bound(1 - r.sign[a])[a] - r.origin[a]) * r.inv_direction[a] * robust_scale;
 			tmin = t0 > tmin ? t0 : tmin;
 			tmax = t1 < tmax ? t1 : tmax;
-			if (tmax <= tmin)
-				return false;
 		}
-		return true;
+		return tmin <= tmax;
 	}
 };
 
-AABB surrounding_box(AABB box0, AABB box1) {
+inline AABB surrounding_box(AABB box0, AABB box1) {
     Vector3 small(fmin(box0.min.x, box1.min.x),
                 fmin(box0.min.y, box1.min.y),
                 fmin(box0.min.z, box1.min.z));
@@ -0,0 +1,33 @@
+#include "AccumulationBuffer.h"
+#include "SampleScheduler.h"
+#include <algorithm>
+
+void AccumulationBuffer::resize(int pixel_count)
+{
+	for (auto* channel : {&sum_r, &sum_g, &sum_b})
+		channel->resize(pixel_count);
+	previous.resize(pixel_count);
+	reset();
+}
+
+void AccumulationBuffer::reset()
+{
+	for (auto* channel : {&sum_r, &sum_g, &sum_b})
+		std::fill(channel->begin(), channel->end(), Sum(0));
+}
+
+void AccumulationBuffer::reproject(const std::vector<int>& source, const SampleScheduler& scheduler)
+{
+	for (auto* channel : {&sum_r, &sum_g, &sum_b})
+	{
+		previous.swap(*channel);
+		for (int pixel = 0; pixel < int(source.size()); pixel++)
+		{
+			const int from = source[pixel];
+			const int previous_count = from >= 0 ? scheduler.getPreviousSampleCount(from) : 0;
+			(*channel)[pixel] = previous_count > 0
+				                    ? previous[from] * Sum(scheduler.getSampleCount(pixel)) / Sum(previous_count)
+				                    : Sum(0);
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+#include "AlignedAllocator.h"
+#include "Globals.h"
+
+class SampleScheduler;
+
+/**
+ * Accumulated image kept as the sum of the samples of each pixel, the mean is only formed when
+ * it is read by dividing by the sample count SampleScheduler keeps. Blending every sample into a
+ * running mean rounds it each time and drifts as counts grow, a sum stays exact up to the
+ * precision of Sum, and adding a sample is three independent adds into separate cache aligned
+ * planes instead of a read, lerp and write of an unaligned Vector3.
+ */
+class AccumulationBuffer
+{
+public:
+#ifdef DOUBLE_ACCUMULATION
+	typedef double Sum;
+#else
+	typedef float Sum;
+#endif
+
+	void resize(int pixel_count);
+
+	//Forgets every sample
+	void reset();
+
+	void add(int pixel, const Vector3& color)
+	{
+		sum_r[pixel] += color.r;
+		sum_g[pixel] += color.g;
+		sum_b[pixel] += color.b;
+	}
+
+	//Mean of the count samples of pixel, black without any
+	Vector3 getMean(int pixel, int count) const
+	{
+		if (count == 0)
+			return Vector3(0);
+		const Sum inverse = Sum(1) / Sum(count);
+		return {float(sum_r[pixel] * inverse), float(sum_g[pixel] * inverse), float(sum_b[pixel] * inverse)};
+	}
+
+	//Pixel i takes over the mean of pixel source[i] of the previous view or starts over when it is -1,
+	//must follow SampleScheduler::reproject since the sums are rescaled to the sample counts it kept
+	void reproject(const std::vector<int>& source, const SampleScheduler& scheduler);
+
+private:
+	AlignedVector<Sum> sum_r, sum_g, sum_b;
+	AlignedVector<Sum> previous;
+};
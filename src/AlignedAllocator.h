@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Allocator for std::vector whose storage starts on a cache line, so full width SIMD loads
+ * from the start of a buffer never straddle two lines and blocks of a buffer that different
+ * threads write never share one.
+ */
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() = default;
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const
+	{
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const
+	{
+		return false;
+	}
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
@@ -0,0 +1,119 @@
+#include "AovBuffer.h"
+#include "SampleScheduler.h"
+#include <algorithm>
+
+void AovBuffer::resize(int width, int height, int channels)
+{
+	this->width = width;
+	this->height = height;
+	this->channels = channels;
+	tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	const size_t size = size_t(tiles_x) * tiles_y * TILE_SIZE * TILE_SIZE;
+
+	for (auto* channel : {&albedo_r, &albedo_g, &albedo_b})
+		channel->resize(has(Albedo) ? size : 0);
+	for (auto* channel : {&normal_x, &normal_y, &normal_z})
+		channel->resize(has(Normal) ? size : 0);
+	depths.resize(has(Depth) ? size : 0);
+	ids.resize(has(Id) ? size : 0);
+	sample_counts.resize(has(SampleCount) ? size : 0);
+	source_index.resize(size_t(width) * height);
+	reset();
+}
+
+void AovBuffer::reset()
+{
+	for (auto* channel : {&albedo_r, &albedo_g, &albedo_b, &normal_x, &normal_y, &normal_z, &depths})
+		std::fill(channel->begin(), channel->end(), 0.f);
+	std::fill(ids.begin(), ids.end(), -1);
+	std::fill(sample_counts.begin(), sample_counts.end(), 0);
+}
+
+template <typename T>
+void AovBuffer::gather(AlignedVector<T>& channel, T missing) const
+{
+	if (channel.empty())
+		return;
+	const AlignedVector<T> previous = channel;
+	for (int row = 0; row < height; row++)
+		for (int x = 0; x < width; x++)
+		{
+			const int source = source_index[row * width + x];
+			channel[index(x, row)] = source >= 0 ? previous[source] : missing;
+		}
+}
+
+void AovBuffer::reproject(const std::vector<int>& source, const std::vector<float>& distance,
+                          const SampleScheduler& scheduler)
+{
+	for (int pixel = 0; pixel < width * height; pixel++)
+		source_index[pixel] = source[pixel] >= 0 ? index(source[pixel] % width, source[pixel] / width) : -1;
+
+	for (auto* channel : {&albedo_r, &albedo_g, &albedo_b, &normal_x, &normal_y, &normal_z})
+		gather(*channel, 0.f);
+	gather(ids, -1);
+
+	//What a pixel shows is now this far away, and it has as many samples as the scheduler let it keep
+	for (int row = 0; row < height; row++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const int pixel = row * width + x;
+			if (has(Depth))
+				depths[index(x, row)] = source[pixel] >= 0 ? distance[pixel] : 0.f;
+			if (has(SampleCount))
+				sample_counts[index(x, row)] = scheduler.getSampleCount(pixel);
+		}
+	}
+}
+
+void AovBuffer::visualize(Channel channel, Vector3* out) const
+{
+	//Depth and sample count are scaled by their largest value in the frame
+	float max_depth = 0.f;
+	int max_count = 0;
+	for (const float depth : depths)
+		max_depth = depth > max_depth ? depth : max_depth;
+	for (const int count : sample_counts)
+		max_count = count > max_count ? count : max_count;
+
+	for (int row = 0; row < height; row++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			Vector3& color = out[row * width + x];
+			if (!has(channel))
+			{
+				color = Vector3(0, 0, 0);
+				continue;
+			}
+			switch (channel)
+			{
+			case Albedo:
+				color = getAlbedo(x, row);
+				break;
+			case Normal:
+				color = getNormal(x, row) * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
+				break;
+			case Depth:
+				color = Vector3(1, 1, 1) * (max_depth > 0.f ? getDepth(x, row) / max_depth : 0.f);
+				break;
+			case Id:
+			{
+				//Neighbouring primitives get unrelated colors
+				const unsigned int hash = unsigned(getId(x, row) + 1) * 2654435761u;
+				color = getId(x, row) < 0
+					        ? Vector3(0, 0, 0)
+					        : Vector3(float(hash >> 24), float((hash >> 16) & 255), float((hash >> 8) & 255)) / 255.f;
+				break;
+			}
+			case SampleCount:
+				color = Vector3(1, 1, 1) * (max_count > 0 ? float(getSampleCount(x, row)) / float(max_count) : 0.f);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
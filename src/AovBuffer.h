@@ -0,0 +1,131 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+#include "AlignedAllocator.h"
+#include "TileRenderer.h"
+
+class SampleScheduler;
+
+/**
+ * Per pixel channels kept next to the AccumulationBuffer, taken from the first surface camera paths find
+ * that is not specular: albedo, normal and the length of the path up to it averaged over the
+ * samples of the pixel, the primitive the first sample found and the sample count. Mirrors and
+ * glass are looked through, so reflections get the values of what they reflect.
+ * Only the channels asked for are allocated and written. Each is its own plane laid out tile
+ * by tile, the tiles of TileRenderer, so the block a thread writes for a tile is contiguous,
+ * starts on a cache line and shares none with the tiles of other threads.
+ */
+class AovBuffer
+{
+public:
+	enum Channel
+	{
+		Albedo = 1,
+		Normal = 2,
+		Depth = 4,
+		Id = 8,
+		SampleCount = 16,
+		AllChannels = 31
+	};
+
+	static const int TILE_SIZE = TileRenderer::TILE_SIZE;
+
+	//Allocates the channels in the Channel mask channels
+	void resize(int width, int height, int channels);
+
+	bool has(Channel channel) const
+	{
+		return (channels & channel) != 0;
+	}
+
+	//Forgets every sample, must be called whenever the AccumulationBuffer is cleared
+	void reset();
+
+	//Pixel i takes the values of pixel source[i] or starts over when it is -1,
+	//distance[i] is how far what it shows is from the new view
+	void reproject(const std::vector<int>& source, const std::vector<float>& distance, const SampleScheduler& scheduler);
+
+	//Offset of pixel x in framebuffer row row in every channel
+	int index(int x, int row) const
+	{
+		return ((row / TILE_SIZE) * tiles_x + x / TILE_SIZE) * (TILE_SIZE * TILE_SIZE) + (row % TILE_SIZE) * TILE_SIZE +
+			x % TILE_SIZE;
+	}
+
+	//Adds the values of a sample to pixel x, row, which has sample_count samples including this one
+	void accumulate(int x, int row, int sample_count, const Vector3& albedo, const Vector3& normal, float depth, int id)
+	{
+		if (channels == 0)
+			return;
+		const int i = index(x, row);
+		const float weight = 1.f / float(sample_count);
+		if (channels & Albedo)
+		{
+			albedo_r[i] += (albedo.r - albedo_r[i]) * weight;
+			albedo_g[i] += (albedo.g - albedo_g[i]) * weight;
+			albedo_b[i] += (albedo.b - albedo_b[i]) * weight;
+		}
+		if (channels & Normal)
+		{
+			normal_x[i] += (normal.x - normal_x[i]) * weight;
+			normal_y[i] += (normal.y - normal_y[i]) * weight;
+			normal_z[i] += (normal.z - normal_z[i]) * weight;
+		}
+		if (channels & Depth)
+			depths[i] += (depth - depths[i]) * weight;
+		//IDs do not average, a pixel keeps the one its first sample found
+		if ((channels & Id) && sample_count == 1)
+			ids[i] = id;
+		if (channels & SampleCount)
+			sample_counts[i] = sample_count;
+	}
+
+	Vector3 getAlbedo(int x, int row) const
+	{
+		const int i = index(x, row);
+		return {albedo_r[i], albedo_g[i], albedo_b[i]};
+	}
+
+	Vector3 getNormal(int x, int row) const
+	{
+		const int i = index(x, row);
+		return {normal_x[i], normal_y[i], normal_z[i]};
+	}
+
+	//Zero where nothing was found
+	float getDepth(int x, int row) const
+	{
+		return depths[index(x, row)];
+	}
+
+	//-1 where nothing was found
+	int getId(int x, int row) const
+	{
+		return ids[index(x, row)];
+	}
+
+	int getSampleCount(int x, int row) const
+	{
+		return sample_counts[index(x, row)];
+	}
+
+	//Writes a color showing channel for every pixel to out, row by row
+	void visualize(Channel channel, Vector3* out) const;
+
+private:
+	int width = 0, height = 0;
+	int tiles_x = 0;
+	int channels = 0;
+
+	AlignedVector<float> albedo_r, albedo_g, albedo_b;
+	AlignedVector<float> normal_x, normal_y, normal_z;
+	AlignedVector<float> depths;
+	AlignedVector<int> ids;
+	AlignedVector<int> sample_counts;
+
+	//Offset in the channels of the source of each pixel in reproject
+	std::vector<int> source_index;
+
+	template <typename T>
+	void gather(AlignedVector<T>& channel, T missing) const;
+};
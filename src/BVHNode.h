@@ -25,6 +25,13 @@ public:
 
 	bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const override;
 	bool bounding_box(float t0, float t1, AABB& b) const override;
+
+	void flatten(PrimitiveStore& store) const override
+	{
+		left->flatten(store);
+		if (right != left)
+			right->flatten(store);
+	}
 };
 
 inline BVHNode::BVHNode(Hitable** l, int n, float time0, float time1)
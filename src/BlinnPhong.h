@@ -4,6 +4,7 @@
 #include "Light.h"
 #include "Camera.h"
 #include "Hitable.h"
+#include "LightTree.h"
 #include <minmax.h>
 
 class BlinnPhong : public Material
@@ -28,6 +29,11 @@ public:
 		this->fuzz = fuzz;
 	}
 
+	Vector3 getAlbedo(const HitRecord& rec) const override
+	{
+		return kd->value(rec.u, rec.v, rec.position);
+	}
+
 
 	Vector3 emitted(const Ray& ray, const HitRecord& rec) const
 	{
@@ -35,7 +41,7 @@ public:
 		Vector3 specular(0);
 		HitRecord shadow_rec;
 
-		for (auto&& light : g_lights)
+		forEachLight(rec, [&](const Light& light, float weight)
 		{
 #ifdef  DISTRIBUTED_RAYS
 			Vector3 light_position = light.getRandomLightPoint() - rec.position;
@@ -52,12 +58,12 @@ public:
 
 			const bool in_shadow = (world->hit(ray, 0.001f, light_position.length() * 0.999f, shadow_rec));
 
-			diffuse += (1.0f - in_shadow) * n_dot_l * light.color * light.power / distance;
+			diffuse += weight * (1.0f - in_shadow) * n_dot_l * light.color * light.power / distance;
 			if (!reflects)
-				specular += (1.0f - in_shadow) * getSpecular(camera.position - rec.position,
-				                                             light_position, rec.normal,
-				                                             light.color, light.power);
-		}
+				specular += weight * (1.0f - in_shadow) * getSpecular(camera.position - rec.position,
+				                                                      light_position, rec.normal,
+				                                                      light.color, light.power);
+		});
 		diffuse /= float(g_lights.size());
 		specular /= float(g_lights.size());
 		diffuse += AMBIENT_LIGHT;
@@ -75,7 +81,7 @@ public:
 	
 		HitRecord shadow_rec;
 		Vector3 specular(0);
-		for (auto&& light : g_lights)
+		forEachLight(rec, [&](const Light& light, float weight)
 		{
 #ifdef  DISTRIBUTED_RAYS
 			Vector3 light_position = light.getRandomLightPoint() - rec.position;
@@ -90,10 +96,10 @@ public:
 			Ray ray(rec.position + rec.normal * 0.01f, light_dir, ray_in.time);
 
 			const bool in_shadow = (world->hit(ray, 0.001f, light_position.length() * 0.999f, shadow_rec));
-			specular += (1.0f - in_shadow) * getSpecular(camera.position - rec.position,
-			                                             light_position, rec.normal,
-			                                             light.color, light.power);
-		}
+			specular += weight * (1.0f - in_shadow) * getSpecular(camera.position - rec.position,
+			                                                      light_position, rec.normal,
+			                                                      light.color, light.power);
+		});
 		specular.clamp(0, 100);
 		attenuation = ks * specular;
 		scattered_ray_out.origin = rec.position;
@@ -107,6 +113,28 @@ public:
 	}
 
 
+	//Calls shade for every light when there are few, otherwise for LIGHT_SAMPLES picks from g_light_tree.
+	//weight rescales each pick so the sum over picks estimates the sum over all lights.
+	template <typename F>
+	void forEachLight(const HitRecord& rec, F&& shade) const
+	{
+		if (int(g_lights.size()) <= LIGHT_SAMPLES)
+		{
+			for (auto&& light : g_lights)
+				shade(light, 1.f);
+			return;
+		}
+
+		for (int s = 0; s < LIGHT_SAMPLES; s++)
+		{
+			float pmf;
+			const int index = g_light_tree.sample(rec.position, rec.normal, Random::randf(0, 1), pmf);
+			if (index < 0)
+				return;
+			shade(g_lights[index], 1.f / (pmf * float(LIGHT_SAMPLES)));
+		}
+	}
+
 	Vector3 getSpecular(const Vector3& view_dir, const Vector3& relative_light_pos, const Vector3& normal,
 	                    const Vector3& light_color, const Vector3& light_power) const
 	{
@@ -0,0 +1,106 @@
+#include "BlueNoiseSampler.h"
+#include <cmath>
+
+BlueNoiseSampler::BlueNoiseSampler(int width) : width(width)
+{
+	generate();
+}
+
+//Void and cluster over a toroidal SIZE x SIZE grid with a Gaussian energy filter.
+//Ranks are assigned by removing points from the tightest clusters of an initial
+//pattern, then by filling the largest voids until the grid is full.
+void BlueNoiseSampler::generate()
+{
+	const int n = SIZE * SIZE;
+	const float sigma = 1.5f;
+
+	std::vector<float> kernel(n);
+	for (int y = 0; y < SIZE; y++)
+	{
+		for (int x = 0; x < SIZE; x++)
+		{
+			const int dx = x < SIZE - x ? x : SIZE - x;
+			const int dy = y < SIZE - y ? y : SIZE - y;
+			kernel[y * SIZE + x] = expf(-float(dx * dx + dy * dy) / (2.f * sigma * sigma));
+		}
+	}
+
+	std::vector<unsigned char> pattern(n, 0);
+	std::vector<float> energy(n, 0.f);
+
+	auto splat = [&](std::vector<float>& e, int p, float sign)
+	{
+		const int px = p % SIZE, py = p / SIZE;
+		for (int y = 0; y < SIZE; y++)
+			for (int x = 0; x < SIZE; x++)
+				e[y * SIZE + x] += sign * kernel[((y - py) & (SIZE - 1)) * SIZE + ((x - px) & (SIZE - 1))];
+	};
+	auto tightest_cluster = [&](const std::vector<unsigned char>& bits, const std::vector<float>& e)
+	{
+		int best = -1;
+		for (int i = 0; i < n; i++)
+			if (bits[i] && (best < 0 || e[i] > e[best]))
+				best = i;
+		return best;
+	};
+	auto largest_void = [&](const std::vector<unsigned char>& bits, const std::vector<float>& e)
+	{
+		int best = -1;
+		for (int i = 0; i < n; i++)
+			if (!bits[i] && (best < 0 || e[i] < e[best]))
+				best = i;
+		return best;
+	};
+
+	//Random initial pattern covering a tenth of the grid
+	const int initial = n / 10;
+	int placed = 0;
+	for (uint32_t i = 0; placed < initial; i++)
+	{
+		const int p = int(hash(i) % uint32_t(n));
+		if (pattern[p])
+			continue;
+		pattern[p] = 1;
+		splat(energy, p, 1.f);
+		placed++;
+	}
+
+	//Move points from the tightest cluster to the largest void until that no longer changes anything
+	while (true)
+	{
+		const int cluster = tightest_cluster(pattern, energy);
+		pattern[cluster] = 0;
+		splat(energy, cluster, -1.f);
+
+		const int hole = largest_void(pattern, energy);
+		pattern[hole] = 1;
+		splat(energy, hole, 1.f);
+		if (hole == cluster)
+			break;
+	}
+
+	std::vector<int> rank(n);
+	{
+		std::vector<unsigned char> bits = pattern;
+		std::vector<float> e = energy;
+		for (int r = initial - 1; r >= 0; r--)
+		{
+			const int cluster = tightest_cluster(bits, e);
+			bits[cluster] = 0;
+			splat(e, cluster, -1.f);
+			rank[cluster] = r;
+		}
+	}
+
+	for (int r = initial; r < n; r++)
+	{
+		const int hole = largest_void(pattern, energy);
+		pattern[hole] = 1;
+		splat(energy, hole, 1.f);
+		rank[hole] = r;
+	}
+
+	mask.resize(n);
+	for (int i = 0; i < n; i++)
+		mask[i] = uint32_t((double(rank[i]) + 0.5) / double(n) * 4294967296.0);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "SobolSampler.h"
+
+/**
+ * Sobol points shared by every pixel, shifted per pixel by a blue noise mask.
+ * At low sample counts the remaining error is spread as high frequency noise
+ * between neighbouring pixels instead of as clumps. Each dimension reads the
+ * mask at a different toroidal offset so dimensions stay decorrelated.
+ */
+class BlueNoiseSampler : public Sampler
+{
+public:
+	//Side of the square mask, tiled over the screen
+	static const int SIZE = 64;
+
+	explicit BlueNoiseSampler(int width);
+
+	float get(int pixel, unsigned int sample, int dimension) const override
+	{
+		const uint32_t seed = hash(uint32_t(dimension >> 1));
+		const uint32_t index = SobolSampler::nestedUniformScramble(sample, seed);
+		const uint32_t value = SobolSampler::nestedUniformScramble(SobolSampler::sobol(index, dimension & 1),
+		                                                           hash(seed, uint32_t(dimension)));
+
+		const uint32_t offset = hash(uint32_t(dimension), 0x5eedU);
+		const int x = (pixel % width + int(offset & 0xffffU)) % SIZE;
+		const int y = (pixel / width + int(offset >> 16)) % SIZE;
+
+		//Cranley-Patterson rotation, wrapping in fixed point keeps the result below 1
+		return toFloat(value + mask[y * SIZE + x]);
+	}
+
+private:
+	int width;
+	//Ranks of the void and cluster pattern scaled to 32 bit fixed point
+	std::vector<uint32_t> mask;
+
+	void generate();
+};
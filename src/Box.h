@@ -25,19 +25,31 @@ public:
 		return true;
 	}
 
-	void updateHitRecord(const Vector3& position, int u, int v, const Vector3& normal, float t, Material* mat_ptr,
-	                     HitRecord& rec) const;
+	static void updateHitRecord(const BoxData& box, const Vector3& position, int u, int v, const Vector3& normal,
+	                            float t, HitRecord& rec);
+
+	void flatten(PrimitiveStore& store) const override
+	{
+		AABB box;
+		bounding_box(store.time0, store.time1, box);
+		store.add(BoxData{center, dimensions, mat_ptr}, box);
+	}
 
 	bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const override
+	{
+		return intersect(BoxData{center, dimensions, mat_ptr}, ray, t_min, t_max, hit_record);
+	}
+
+	static bool intersect(const BoxData& box, const Ray& ray, float t_min, float t_max, HitRecord& hit_record)
 	{
 		bool hit_anything = false;
 		//6 Bounding Box sides
-		float BOTTOM = center.y - dimensions.y / 2;
-		float TOP = center.y + dimensions.y / 2;
-		float BACK = center.z - dimensions.z / 2;
-		float FRONT = center.z + dimensions.z / 2;
-		float LEFT = center.x - dimensions.x / 2;
-		float RIGHT = center.x + dimensions.x / 2;
+		float BOTTOM = box.center.y - box.dimensions.y / 2;
+		float TOP = box.center.y + box.dimensions.y / 2;
+		float BACK = box.center.z - box.dimensions.z / 2;
+		float FRONT = box.center.z + box.dimensions.z / 2;
+		float LEFT = box.center.x - box.dimensions.x / 2;
+		float RIGHT = box.center.x + box.dimensions.x / 2;
 
 
 		//Calculates the position the ray would intersect with each plane
@@ -55,7 +67,7 @@ public:
 			if (!hit_anything || t < hit_record.t)
 				if (t > t_min && t < t_max)
 				{
-					updateHitRecord(p, 1, 2, Vector3::UNIT_X_NEG, t, mat_ptr, hit_record);
+					updateHitRecord(box, p, 1, 2, Vector3::UNIT_X_NEG, t, hit_record);
 					hit_anything = true;
 				}
 		}
@@ -68,7 +80,7 @@ public:
 			if (!hit_anything || t < hit_record.t)
 				if (t > t_min && t < t_max)
 				{
-					updateHitRecord(p, 1, 2, Vector3::UNIT_X_POS, t, mat_ptr, hit_record);
+					updateHitRecord(box, p, 1, 2, Vector3::UNIT_X_POS, t, hit_record);
 					hit_anything = true;
 				}
 		}
@@ -82,7 +94,7 @@ public:
 			if (!hit_anything || t < hit_record.t)
 				if (t > t_min && t < t_max)
 				{
-					updateHitRecord(p, 0, 2, Vector3::UNIT_Y_NEG, t, mat_ptr, hit_record);
+					updateHitRecord(box, p, 0, 2, Vector3::UNIT_Y_NEG, t, hit_record);
 					hit_anything = true;
 				}
 		}
@@ -95,7 +107,7 @@ public:
 			if (!hit_anything || t < hit_record.t)
 				if (t > t_min && t < t_max)
 				{
-					updateHitRecord(p, 0, 2, Vector3::UNIT_Y_POS, t, mat_ptr, hit_record);
+					updateHitRecord(box, p, 0, 2, Vector3::UNIT_Y_POS, t, hit_record);
 					hit_anything = true;
 				}
 		}
@@ -108,7 +120,7 @@ public:
 			if (!hit_anything || t < hit_record.t)
 				if (t > t_min && t < t_max)
 				{
-					updateHitRecord(p, 0, 1, Vector3::UNIT_Z_NEG, t, mat_ptr, hit_record);
+					updateHitRecord(box, p, 0, 1, Vector3::UNIT_Z_NEG, t, hit_record);
 					hit_anything = true;
 				}
 		}
@@ -121,7 +133,7 @@ public:
 			if (!hit_anything || t < hit_record.t)
 				if (t > t_min && t < t_max)
 				{
-					updateHitRecord(p, 0, 1, Vector3::UNIT_Z_POS, t, mat_ptr, hit_record);
+					updateHitRecord(box, p, 0, 1, Vector3::UNIT_Z_POS, t, hit_record);
 					hit_anything = true;
 				}
 		}
@@ -129,15 +141,15 @@ public:
 	}
 };
 
-void Box::updateHitRecord(const Vector3& position, int u, int v, const Vector3& normal, float t, Material* mat_ptr,
-                          HitRecord& rec) const
+inline void Box::updateHitRecord(const BoxData& box, const Vector3& position, int u, int v, const Vector3& normal,
+                                float t, HitRecord& rec)
 {
 	HitRecord temp;
 	temp.position = position;
 	temp.normal = normal;
 	temp.t = t;
-	temp.mat_ptr = mat_ptr;
-	temp.u = ((position[u] - center[u]) / dimensions[u] + 1.0f) * 0.5f;
-	temp.v = ((position[v] - center[v]) / dimensions[v] + 1.0f) * 0.5f;
+	temp.mat_ptr = box.mat_ptr;
+	temp.u = ((position[u] - box.center[u]) / box.dimensions[u] + 1.0f) * 0.5f;
+	temp.v = ((position[v] - box.center[v]) / box.dimensions[v] + 1.0f) * 0.5f;
 	rec = temp;
 }
@@ -2,6 +2,7 @@
 #include <iostream>
 #include "Math.h"
 #include "Random.h"
+#include "Sampling.h"
 #include "Quat.h"
 
 constexpr float M_PI = 3.141592653589793238462643383279502884f; /* pi */
@@ -45,10 +46,17 @@ Camera::Camera(const Vector3& eye, const Vector3& target, const Vector3& up, flo
 
 Ray Camera::getRay(float x, float y) const
 {
-	Vector3 rd = lens_radius * Random::random_in_unit_disk();
+	const float lens_u = Random::randf(0, 1);
+	const float lens_v = Random::randf(0, 1);
+	return getRay(x, y, lens_u, lens_v, Random::randf(0, 1));
+}
+
+Ray Camera::getRay(float x, float y, float lens_u, float lens_v, float time_u) const
+{
+	Vector3 rd = lens_radius * sample_concentric_disk(lens_u, lens_v);
 	Vector3 offset = u * rd.x + v * rd.y;
 
-	float time = Random::randf(time0, time1);
+	float time = time0 + time_u * (time1 - time0);
 
 	Vector3 origin = this->position + offset;
 
@@ -35,6 +35,8 @@ public:
 	       float focus_dist, float t0 = 0.f, float t1 = 0.f);
 
 	Ray getRay(float x, float y) const;
+	//Ray through x, y with the lens point and shutter time picked by sample values in [0, 1)
+	Ray getRay(float x, float y, float lens_u, float lens_v, float time_u) const;
 
 	Vector3 getForward() const;
 	Vector3 getRight() const;
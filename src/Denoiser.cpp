@@ -0,0 +1,208 @@
+#include "Denoiser.h"
+#include "AovBuffer.h"
+#include "SampleScheduler.h"
+#include "Simd.h"
+#include <cmath>
+
+namespace
+{
+	//Smallest albedo divided out of the lighting, black surfaces would blow up their noise
+	const float MIN_ALBEDO = 0.01f;
+
+	//exp(-x) through the reciprocal of its cubic Taylor expansion, accurate enough for a falloff
+	//and only adds, multiplies and one division
+	simd_f32 falloff(simd_f32 x)
+	{
+		const simd_f32 one = simd_set(1.f);
+		const simd_f32 series = simd_add(one, simd_mul(x, simd_add(one, simd_mul(x, simd_add(simd_set(0.5f),
+		                                                                             simd_mul(x, simd_set(1.f / 6.f)))))));
+		return simd_div(one, series);
+	}
+
+	simd_f32 abs_difference(simd_f32 a, simd_f32 b)
+	{
+		return simd_max(simd_sub(a, b), simd_sub(b, a));
+	}
+
+	simd_f32 luminance(simd_f32 r, simd_f32 g, simd_f32 b)
+	{
+		return simd_add(simd_add(simd_mul(simd_set(0.2126f), r), simd_mul(simd_set(0.7152f), g)),
+		                simd_mul(simd_set(0.0722f), b));
+	}
+}
+
+void Denoiser::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	pitch = width + 2 * PAD + SIMD_LANES;
+	const size_t size = size_t(pitch) * (height + 2 * PAD);
+	for (auto& set : lighting)
+		for (auto& channel : set)
+			channel.assign(size, 0.f);
+	for (int c = 0; c < 3; c++)
+	{
+		normal[c].assign(size, 0.f);
+		albedo[c].assign(size, 0.f);
+	}
+	depth.assign(size, 0.f);
+	variance.assign(size, -1.f);
+	inverse_sigma.assign(size, 0.f);
+	inverse_depth.assign(size, 0.f);
+}
+
+void Denoiser::load(const Vector3* color, const AovBuffer& aovs, const SampleScheduler& scheduler)
+{
+#pragma omp parallel for
+	for (int row = 0; row < height; row++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const int pixel = row * width + x;
+			const int i = index(x, row);
+			Vector3 a = aovs.getAlbedo(x, row);
+			for (int c = 0; c < 3; c++)
+				a.data[c] = a.data[c] > MIN_ALBEDO ? a.data[c] : MIN_ALBEDO;
+			for (int c = 0; c < 3; c++)
+			{
+				albedo[c][i] = a.data[c];
+				lighting[0][c][i] = color[pixel].data[c] / a.data[c];
+			}
+			//Pixels covering several surfaces average to shorter normals, which would not even match themselves
+			const Vector3 n = aovs.getNormal(x, row);
+			const float length = n.length();
+			for (int c = 0; c < 3; c++)
+				normal[c][i] = length > 0.f ? n.data[c] / length : 0.f;
+			depth[i] = aovs.getDepth(x, row);
+			inverse_depth[i] = depth[i] > 0.f ? 1.f / (settings.depth_sigma * depth[i]) : 0.f;
+
+			//The variance is of the color, dividing by the albedo scales the lighting noise up the same way
+			const float albedo_luminance = 0.2126f * a.r + 0.7152f * a.g + 0.0722f * a.b;
+			const float color_variance = scheduler.getVariance(pixel);
+			variance[i] = color_variance < 0.f ? -1.f : color_variance / (albedo_luminance * albedo_luminance);
+		}
+	}
+}
+
+void Denoiser::estimateSigma()
+{
+	static const float KERNEL[3] = {1.f / 4.f, 1.f / 2.f, 1.f / 4.f};
+
+#pragma omp parallel for
+	for (int row = 0; row < height; row++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const int p = index(x, row);
+			if (variance[p] < 0.f)
+			{
+				inverse_sigma[p] = 0.f;
+				continue;
+			}
+			float sum = 0.f, sum_weight = 0.f;
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const int q = p + dy * pitch + dx;
+					if (variance[q] < 0.f)
+						continue;
+					const float weight = KERNEL[dx + 1] * KERNEL[dy + 1];
+					sum += variance[q] * weight;
+					sum_weight += weight;
+				}
+			}
+			inverse_sigma[p] = 1.f / (settings.luminance_sigma * sqrtf(sum / sum_weight) + 1e-6f);
+		}
+	}
+}
+
+void Denoiser::iterate(int iteration, const std::vector<float>* in, std::vector<float>* out) const
+{
+	static const float KERNEL[5] = {1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+	const int step = 1 << iteration;
+	//Noise left after each pass is about half, so the luminance tolerance halves with it
+	const simd_f32 sigma_scale = simd_set(float(step));
+	const int normal_sharpness = settings.normal_sharpness;
+	const simd_f32 zero = simd_set(0.f);
+
+#pragma omp parallel for
+	for (int row = 0; row < height; row++)
+	{
+		for (int x = 0; x < width; x += SIMD_LANES)
+		{
+			const int p = index(x, row);
+			const simd_f32 r_p = simd_load(&in[0][p]), g_p = simd_load(&in[1][p]), b_p = simd_load(&in[2][p]);
+			const simd_f32 nx_p = simd_load(&normal[0][p]), ny_p = simd_load(&normal[1][p]);
+			const simd_f32 nz_p = simd_load(&normal[2][p]);
+			const simd_f32 depth_p = simd_load(&depth[p]);
+			const simd_f32 inverse_depth_p = simd_load(&inverse_depth[p]);
+			const simd_f32 luminance_p = luminance(r_p, g_p, b_p);
+			const simd_f32 inverse_sigma_p = simd_mul(simd_load(&inverse_sigma[p]), sigma_scale);
+
+			//The centre tap always counts in full, pixels without guides keep their own value
+			const simd_f32 centre = simd_set(KERNEL[2] * KERNEL[2]);
+			simd_f32 sum_r = simd_mul(r_p, centre), sum_g = simd_mul(g_p, centre), sum_b = simd_mul(b_p, centre);
+			simd_f32 sum_weight = centre;
+
+			for (int dy = -2; dy <= 2; dy++)
+			{
+				for (int dx = -2; dx <= 2; dx++)
+				{
+					if (dx == 0 && dy == 0)
+						continue;
+					const int q = p + (dy * pitch + dx) * step;
+					const simd_f32 r_q = simd_load(&in[0][q]), g_q = simd_load(&in[1][q]), b_q = simd_load(&in[2][q]);
+
+					simd_f32 cos_normal = simd_add(simd_add(simd_mul(nx_p, simd_load(&normal[0][q])),
+					                                        simd_mul(ny_p, simd_load(&normal[1][q]))),
+					                               simd_mul(nz_p, simd_load(&normal[2][q])));
+					cos_normal = simd_max(cos_normal, zero);
+					for (int k = 0; k < normal_sharpness; k++)
+						cos_normal = simd_mul(cos_normal, cos_normal);
+
+					//Depth may change linearly across a surface, so the tolerance grows with the tap distance
+					const float tap_distance = float((dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy)) * float(step);
+					const simd_f32 depth_x = simd_mul(abs_difference(depth_p, simd_load(&depth[q])),
+					                                  simd_mul(inverse_depth_p, simd_set(1.f / tap_distance)));
+
+					const simd_f32 luminance_x = simd_mul(abs_difference(luminance_p, luminance(r_q, g_q, b_q)),
+					                                      inverse_sigma_p);
+
+					const simd_f32 weight = simd_mul(simd_mul(simd_set(KERNEL[dx + 2] * KERNEL[dy + 2]), cos_normal),
+					                                 falloff(simd_add(depth_x, luminance_x)));
+					sum_r = simd_add(sum_r, simd_mul(r_q, weight));
+					sum_g = simd_add(sum_g, simd_mul(g_q, weight));
+					sum_b = simd_add(sum_b, simd_mul(b_q, weight));
+					sum_weight = simd_add(sum_weight, weight);
+				}
+			}
+
+			simd_store(&out[0][p], simd_div(sum_r, sum_weight));
+			simd_store(&out[1][p], simd_div(sum_g, sum_weight));
+			simd_store(&out[2][p], simd_div(sum_b, sum_weight));
+		}
+	}
+}
+
+void Denoiser::denoise(const Vector3* color, const AovBuffer& aovs, const SampleScheduler& scheduler, Vector3* out)
+{
+	load(color, aovs, scheduler);
+	estimateSigma();
+
+	const int iterations = settings.iterations < MAX_ITERATIONS ? settings.iterations : MAX_ITERATIONS;
+	int current = 0;
+	for (int iteration = 0; iteration < iterations; iteration++, current ^= 1)
+		iterate(iteration, lighting[current], lighting[current ^ 1]);
+
+#pragma omp parallel for
+	for (int row = 0; row < height; row++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const int i = index(x, row);
+			out[row * width + x] = Vector3(lighting[current][0][i] * albedo[0][i], lighting[current][1][i] * albedo[1][i],
+			                               lighting[current][2][i] * albedo[2][i]);
+		}
+	}
+}
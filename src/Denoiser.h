@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+
+class AovBuffer;
+class SampleScheduler;
+
+/**
+ * Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) guided by the albedo, normal
+ * and depth channels of an AovBuffer.
+ * Each iteration blurs with a 5x5 B3 spline kernel whose taps are spread twice as far
+ * as in the previous one. Taps are weighted down where the normal, depth or luminance
+ * differs from the centre pixel, so edges and texture survive. The luminance tolerance is
+ * the standard error of the pixel mean, blurred over 3x3 pixels first since a handful of
+ * samples that all missed the light claim no noise at all. Converged pixels are left as they are.
+ * Lighting is filtered with the albedo divided out and multiplied back afterwards.
+ * Rows run in parallel and SIMD_LANES neighbouring pixels are filtered together.
+ */
+class Denoiser
+{
+public:
+	static const int MAX_ITERATIONS = 5;
+
+	struct Settings
+	{
+		//Passes of the filter, the footprint doubles with each
+		int iterations = 2;
+		//Standard errors of the pixel mean within which luminance counts as the same
+		float luminance_sigma = 4.f;
+		//Normals are weighted by their dot product raised to the power of two to this
+		int normal_sharpness = 2;
+		//Depth difference, relative to depth and tap distance in pixels, that halves the weight
+		float depth_sigma = 0.05f;
+	};
+
+	Settings settings;
+
+	void resize(int width, int height);
+
+	//Filters color into out, which may be the same buffer
+	void denoise(const Vector3* color, const AovBuffer& aovs, const SampleScheduler& scheduler, Vector3* out);
+
+private:
+	//Border around the planes wide enough for the taps of the last iteration
+	static const int PAD = 2 << (MAX_ITERATIONS - 1);
+
+	int width = 0, height = 0;
+	//Row pitch of the padded planes, the right border is one set of lanes wider for the last loads of a row
+	int pitch = 0;
+
+	//Lighting with the albedo divided out, read from one set and written to the other
+	std::vector<float> lighting[2][3];
+	//Zero in the border and where nothing was found, which takes away all weight from those taps
+	std::vector<float> normal[3];
+	std::vector<float> depth;
+	//Variance of the lighting mean, negative where there is no estimate yet
+	std::vector<float> variance;
+	//Inverse of the luminance tolerance of each pixel, zero where there is no estimate yet
+	std::vector<float> inverse_sigma;
+	//Inverse of depth times depth_sigma, zero where nothing was hit
+	std::vector<float> inverse_depth;
+	std::vector<float> albedo[3];
+
+	int index(int x, int row) const
+	{
+		return (row + PAD) * pitch + x + PAD;
+	}
+
+	void load(const Vector3* color, const AovBuffer& aovs, const SampleScheduler& scheduler);
+	void estimateSigma();
+	void iterate(int iteration, const std::vector<float>* in, std::vector<float>* out) const;
+};
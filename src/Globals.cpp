@@ -3,12 +3,21 @@
 #include "Camera.h"
 #include "BlinnPhong.h"
 #include "Metal.h"
+#include "LightTree.h"
+#include "SobolSampler.h"
+#include "BlueNoiseSampler.h"
+#include "Tonemap.h"
 
 const int SCREEN_WIDTH = 400;
 const int SCREEN_HEIGHT = 250;
 const float ASPECT_RATIO = float(SCREEN_WIDTH) / float(SCREEN_HEIGHT);
 
+const double FRAME_TIME_BUDGET = 16.0;
+const float FOCUS_RADIUS = 48.f;
+
 const int MAX_RAY_DEPTH = 32;
+const int RUSSIAN_ROULETTE_DEPTH = 3;
+const float MIN_THROUGHPUT = 0.0001f;
 
 int mouse_x = 0;
 int mouse_y = 0;
@@ -16,13 +25,28 @@ bool mouse_down = false;
 
 const Vector3 LIGHT_DIR = Vector3(1.0f, 1.0f, 0.0f).getNormalized();
 const Vector3 LIGHT_POS = Vector3(0, 4.9f, 0.f);
-const Vector3 LIGHT_POWER = Vector3(1);
+const Vector3 LIGHT_POWER = Vector3(150);
 const Vector3 AMBIENT_LIGHT = Vector3(0.2f, 0.2f, 0.2f);
 
 Camera camera = Camera();
 Hitable* world = NULL;
+#ifdef BLUE_NOISE_SAMPLER
+Sampler* g_sampler = new BlueNoiseSampler(SCREEN_WIDTH);
+#else
+Sampler* g_sampler = new SobolSampler();
+#endif
 
 std::vector<Light> g_lights = {};
+LightTree g_light_tree = LightTree();
+const int LIGHT_SAMPLES = 4;
+
+PathGuide* g_path_guide = NULL;
+const size_t PATH_GUIDE_MEMORY = 16 * 1024 * 1024;
+
+LightTracer* g_light_tracer = NULL;
+PhotonMapper* g_photon_mapper = NULL;
+
+ToneOperator* g_tone_operator = new FilmicToneOperator();
 
 const Vector3 red_color = Vector3(.65f, .05f, .05f);
 const Vector3 blue_color = Vector3(.12f, .15f, .56f);
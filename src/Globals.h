@@ -5,11 +5,50 @@ class Vector3;
 class Camera;
 class Material;
 class Hitable;
+class LightTree;
+class Sampler;
+class PathGuide;
+class LightTracer;
+class PhotonMapper;
+class ToneOperator;
 
 #define global_extern extern
 
 #define PATH_TRACING
 #define DISTRIBUTED_RAYS
+//Reuse primary hits and perfect mirror bounces while the camera is still
+#define PRIMARY_CACHE
+//Carry the accumulated image over to the new view when the camera moves instead of starting over
+#define TEMPORAL_REPROJECTION
+//Sample one pixel in 16 and then one in 4 right after the camera moves, so the new view shows up sooner
+#define PROGRESSIVE_REFINEMENT
+//Instead of always starting at one pixel in 16, pick the resolution of frames after a move to hold FRAME_TIME_BUDGET
+#define DYNAMIC_RESOLUTION
+//Filter the displayed image with an edge-avoiding wavelet guided by albedo, normal and depth, the accumulated samples stay as they are
+#define DENOISING
+//Let F switch to spending most of each frame's samples around the mouse cursor, falling off over FOCUS_RADIUS
+#define FOVEATED_SAMPLING
+//Sum samples in double precision, only matters for pixels that collect very many samples
+//#define DOUBLE_ACCUMULATION
+//Keep every AOV channel, including object ID and sample count, and cycle the display through them with V
+//#define AOV_DEBUG_VIEWS
+//Decorrelate pixels with a blue noise mask instead of per pixel scrambling, best at very low sample counts
+//#define BLUE_NOISE_SAMPLER
+//Learn where light comes from while rendering and steer diffuse bounces towards it
+#define PATH_GUIDING
+//Trace caustics from the lights and splat them instead of waiting for camera paths to find them.
+//Only helps where the camera sees the diffuse surface the caustic lands on directly.
+//#define LIGHT_TRACING
+//Gather caustics from photons, this also reaches the ones the camera sees through mirrors.
+//Frames cost about four times as much, with the ceiling wide light of the default scene it only breaks even.
+//#define PHOTON_MAPPING
+
+#if defined(LIGHT_TRACING) && defined(PHOTON_MAPPING)
+#error LIGHT_TRACING and PHOTON_MAPPING both take the caustics out of the path tracer, only one can be on
+#endif
+
+//M_PI needs _USE_MATH_DEFINES on MSVC, so headers use this instead
+const float PI = 3.14159265358979323846f;
 
 global_extern int mouse_x,mouse_y;
 global_extern bool mouse_down;
@@ -18,18 +57,47 @@ global_extern const int SCREEN_WIDTH;
 global_extern const int SCREEN_HEIGHT;
 global_extern const float ASPECT_RATIO;
 
+//Milliseconds a frame may take while the camera moves, with DYNAMIC_RESOLUTION
+global_extern const double FRAME_TIME_BUDGET;
+//Pixels from the cursor at which tiles get half the samples, with FOVEATED_SAMPLING
+global_extern const float FOCUS_RADIUS;
+
 global_extern const int MAX_RAY_DEPTH;
+//Bounce after which paths are randomly terminated based on their throughput
+global_extern const int RUSSIAN_ROULETTE_DEPTH;
+//Paths whose throughput falls below this can no longer contribute visibly
+global_extern const float MIN_THROUGHPUT;
 
 global_extern const Vector3 LIGHT_DIR;
 global_extern const Vector3 LIGHT_POS;
+//Scales the emitted colour of registered area lights for BlinnPhong, 150 * 2 matches the old hand-placed light
 global_extern const Vector3 LIGHT_POWER;
 global_extern const Vector3 AMBIENT_LIGHT;
 
 //Pos, normal, up, vFov, aspect ratio
 global_extern Camera camera;
 global_extern Hitable* world;
+//Sample values for the camera and every bounce of the path tracer
+global_extern Sampler* g_sampler;
 
 global_extern std::vector<Light> g_lights;
+//Hierarchy over g_lights, must be rebuilt whenever g_lights changes
+global_extern LightTree g_light_tree;
+//Materials shading against more lights than this pick this many from g_light_tree instead
+global_extern const int LIGHT_SAMPLES;
+
+//Learned incident light, null when PATH_GUIDING is off or before the scene is known
+global_extern PathGuide* g_path_guide;
+//Bytes the trees of g_path_guide may grow to
+global_extern const size_t PATH_GUIDE_MEMORY;
+
+//Splats the caustics the path tracer leaves out, null when LIGHT_TRACING is off
+global_extern LightTracer* g_light_tracer;
+//Gathers the caustics the path tracer leaves out, null when PHOTON_MAPPING is off
+global_extern PhotonMapper* g_photon_mapper;
+
+//Curve presented frames are mapped to display colors with
+global_extern ToneOperator* g_tone_operator;
 
 global_extern const Vector3 red_color;
 global_extern const Vector3 blue_color;
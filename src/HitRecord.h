@@ -16,6 +16,7 @@ public:
 	Vector3 position{};	//The position in world coordinates of the intersection
 	Vector3 normal{};	//The normal of the object at the intersection point
 	float u,v; //Texture coords
+	int primitive = -1;	//Index of the primitive in the committed scene, -1 if not hit through one
 	HitRecord() = default;
 };
 
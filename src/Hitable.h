@@ -1,7 +1,8 @@
 #pragma once
+#include <cfloat>
 #include "HitRecord.h"
 #include "Ray.h"
-class AABB;
+#include "PrimitiveStore.h"
 
 
 //An abstract hittable object that is inherited so hittable objects
@@ -19,6 +20,15 @@ public:
 	//this is the z far plane
 	virtual bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const = 0;
 	virtual bool bounding_box(float t0, float t1, AABB& b) const = 0;
+
+	//Adds this object to the store a scene is committed to. Objects without a closed
+	//representation are stored as generic entries and still hit through this interface.
+	virtual void flatten(PrimitiveStore& store) const
+	{
+		AABB box(Vector3(-FLT_MAX), Vector3(FLT_MAX));
+		bounding_box(store.time0, store.time1, box);
+		store.add(this, box);
+	}
 };
 
 
@@ -21,9 +21,15 @@ public:
 
 	bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const;
 	bool bounding_box(float t0, float t1, AABB& b) const override;
+
+	void flatten(PrimitiveStore& store) const override
+	{
+		for (auto i = 0; i < list_size; i++)
+			list[i]->flatten(store);
+	}
 };
 
-bool HitableList::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const
+inline bool HitableList::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const
 {
 	HitRecord temp_rec;
 	HitRecord saved_temp_rec;
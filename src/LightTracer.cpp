@@ -0,0 +1,145 @@
+#include "LightTracer.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "Material.h"
+#include "Random.h"
+#include "Sampling.h"
+#include "Globals.h"
+#include <cfloat>
+
+//Stream dimension the light paths draw from, apart from the blocks the camera paths use
+static const uint32_t LIGHT_STREAM = 0x80000000U;
+
+void LightTracer::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	splats.resize(size_t(width) * height);
+	reset();
+}
+
+void LightTracer::reset()
+{
+	for (Vector3& s : splats)
+		s = Vector3(0.f);
+	paths_traced = 0;
+}
+
+void LightTracer::trace(const Scene& scene, const Camera& camera, int count)
+{
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < count; i++)
+		tracePath(scene, camera, uint32_t(i));
+
+	paths_traced += count;
+	frame++;
+}
+
+void LightTracer::splat(int pixel, const Vector3& color)
+{
+	float& r = splats[pixel].r;
+	float& g = splats[pixel].g;
+	float& b = splats[pixel].b;
+#pragma omp atomic
+	r += color.r;
+#pragma omp atomic
+	g += color.g;
+#pragma omp atomic
+	b += color.b;
+}
+
+bool LightTracer::startPath(const Scene& scene, float time, const float* u, Ray& ray, Vector3& throughput)
+{
+	LightSample light;
+	if (!scene.sampleEmission(time, u[0], u[1], u[2], light))
+		return false;
+
+	//Lights emit from both faces, each face gets a cosine distributed half of the paths
+	const bool back = u[3] < 0.5f;
+	const Vector3 normal = back ? -light.normal : light.normal;
+	const float u_side = back ? u[3] * 2.f : (u[3] - 0.5f) * 2.f;
+	ray = Ray(light.position, sample_cosine_direction(normal, u_side, u[4]), time);
+
+	//Emission times cosine over the densities of point and direction, cos / PI / 2
+	throughput = light.emitted * (2.f * PI / light.pdf_area);
+	return true;
+}
+
+void LightTracer::tracePath(const Scene& scene, const Camera& camera, uint32_t index)
+{
+	Random::setStream(index, frame, LIGHT_STREAM);
+	float u[6];
+	Random::fill(u, 6);
+
+	const float time = camera.time0 + u[0] * (camera.time1 - camera.time0);
+	Ray ray;
+	Vector3 throughput;
+	if (!startPath(scene, time, u + 1, ray, throughput))
+		return;
+
+	int specular_bounces = 0;
+	for (int depth = 0; depth < MAX_RAY_DEPTH; depth++)
+	{
+		HitRecord rec;
+		if (!scene.hit(ray, 0.001f, FLT_MAX, rec))
+			return;
+
+		const MaterialType type = rec.mat_ptr->type;
+		if (type == MaterialType::DiffuseLight)
+			return;
+
+		if (type == MaterialType::Lambertian)
+		{
+			if (specular_bounces == 0)
+				return;
+
+			const Vector3 to_camera = camera.position - rec.position;
+			const float distance_squared = to_camera.dot(to_camera);
+			const float distance = sqrtf(distance_squared);
+			const Vector3 direction = to_camera / distance;
+
+			//Light arrives and leaves on the same side of the surface
+			const float cos_surface = rec.normal.dot(direction);
+			if (cos_surface * rec.normal.dot(ray.direction) >= 0.f)
+				return;
+
+			//The camera looks down -w
+			const Vector3 view = rec.position - camera.position;
+			const float depth_along = -view.dot(camera.w);
+			if (depth_along <= 0.f)
+				return;
+
+			const float image_x = (view.dot(camera.u) / depth_along / camera.half_width + 1.f) * 0.5f;
+			const float image_y = (view.dot(camera.v) / depth_along / camera.half_height + 1.f) * 0.5f;
+			if (image_x < 0.f || image_x >= 1.f || image_y < 0.f || image_y >= 1.f)
+				return;
+
+			if (scene.occluded(Ray(rec.position, direction, time), 0.001f, distance * 0.999f))
+				return;
+
+			//Pinhole importance is pixel count / (image area at unit distance * cos^4), one cos cancels the
+			//cosine at the camera in the geometry term
+			const float cos_camera = depth_along / distance;
+			const float image_area = 4.f * camera.half_width * camera.half_height;
+			const float importance = float(width * height) / (image_area * cos_camera * cos_camera * cos_camera);
+
+			const Lambertian* mat = static_cast<const Lambertian*>(rec.mat_ptr);
+			const Vector3 albedo = mat->albedo->value(rec.u, rec.v, rec.position);
+			const Vector3 color = throughput * albedo * (fabsf(cos_surface) / PI * importance / distance_squared);
+
+			const int x = int(image_x * float(width));
+			const int y = int(image_y * float(height));
+			splat((height - y - 1) * width + x, color);
+			return;
+		}
+
+		//Everything else scatters like the path tracer treats it, as a specular bounce
+		Vector3 attenuation;
+		Ray scattered;
+		if (!rec.mat_ptr->scatter(ray, rec, attenuation, scattered))
+			return;
+		throughput = throughput * attenuation;
+		ray = Ray(scattered.origin, scattered.direction.getNormalized(), time);
+		specular_bounces++;
+	}
+}
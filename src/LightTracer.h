@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Vector3.h"
+#include "Ray.h"
+
+class Scene;
+class Camera;
+
+/**
+ * Traces paths from the lights and splats what they carry into the image where they
+ * meet a diffuse surface the camera sees. Only caustic paths are kept, those that
+ * passed at least one specular bounce before that surface: they are the paths the
+ * camera side can only find by chance, and the path tracer drops them in turn so
+ * both halves add up to the full image.
+ * Splats land anywhere in the image, so they are added atomically.
+ */
+class LightTracer
+{
+public:
+	//Light paths traced per frame
+	static const int PATHS_PER_FRAME = 1 << 16;
+
+	void resize(int width, int height);
+
+	//Forgets every splat, must be called whenever the camera moves
+	void reset();
+
+	//Traces count paths from the lights of scene and splats their caustics as seen from camera.
+	//The camera is treated as a pinhole.
+	void trace(const Scene& scene, const Camera& camera, int count);
+
+	//Starts a path on a light of scene with five sample values in u, throughput is its weight
+	static bool startPath(const Scene& scene, float time, const float* u, Ray& ray, Vector3& throughput);
+
+	//Splatted radiance of pixel averaged over every light path so far
+	Vector3 getRadiance(int pixel) const
+	{
+		return paths_traced ? splats[pixel] * float(1.0 / double(paths_traced)) : Vector3(0.f);
+	}
+
+private:
+	int width = 0, height = 0;
+	std::vector<Vector3> splats;
+	uint64_t paths_traced = 0;
+	uint32_t frame = 0;
+
+	void tracePath(const Scene& scene, const Camera& camera, uint32_t index);
+	void splat(int pixel, const Vector3& color);
+};
@@ -0,0 +1,168 @@
+#include "LightTree.h"
+#include <algorithm>
+#include <cmath>
+
+void LightTree::build(const std::vector<AABB>& bounds, const std::vector<float>& power)
+{
+	nodes.clear();
+	leaf_of_light.assign(bounds.size(), -1);
+
+	const int count = int(bounds.size());
+	if (count == 0)
+		return;
+
+	std::vector<Vector3> centroids(count);
+	std::vector<int> indices(count);
+	for (int i = 0; i < count; i++)
+	{
+		centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+		indices[i] = i;
+	}
+
+	nodes.reserve(2 * count);
+	build(indices, 0, count, -1, bounds, power, centroids);
+}
+
+void LightTree::build(const std::vector<Light>& lights)
+{
+	std::vector<AABB> bounds;
+	std::vector<float> power;
+	for (const Light& light : lights)
+	{
+		const Vector3 emitted = light.color * light.power;
+		bounds.emplace_back(light.center - light.dimensions * 0.5f, light.center + light.dimensions * 0.5f);
+		power.push_back((emitted.r + emitted.g + emitted.b) / 3.f);
+	}
+	build(bounds, power);
+}
+
+//Splits at the median centroid along the axis of largest centroid extent, one light per leaf
+int LightTree::build(std::vector<int>& indices, int begin, int end, int parent, const std::vector<AABB>& bounds,
+                     const std::vector<float>& power, const std::vector<Vector3>& centroids)
+{
+	const int node_index = int(nodes.size());
+	nodes.push_back(Node());
+
+	if (end - begin == 1)
+	{
+		const int light = indices[begin];
+		Node& leaf = nodes[node_index];
+		leaf.box = bounds[light];
+		leaf.power = power[light];
+		leaf.offset = light;
+		leaf.parent = parent;
+		leaf.leaf = true;
+		leaf_of_light[light] = node_index;
+		return node_index;
+	}
+
+	AABB centroid_box(centroids[indices[begin]], centroids[indices[begin]]);
+	for (int i = begin + 1; i < end; i++)
+		centroid_box = surrounding_box(centroid_box, AABB(centroids[indices[i]], centroids[indices[i]]));
+
+	const int axis = (centroid_box.max - centroid_box.min).getLargestComponentIndex();
+	const int mid = begin + (end - begin) / 2;
+	std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+	                 [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	const int first = build(indices, begin, mid, node_index, bounds, power, centroids);
+	const int second = build(indices, mid, end, node_index, bounds, power, centroids);
+
+	Node& node = nodes[node_index];
+	node.box = surrounding_box(nodes[first].box, nodes[second].box);
+	node.power = nodes[first].power + nodes[second].power;
+	node.offset = second;
+	node.parent = parent;
+	node.leaf = false;
+	return node_index;
+}
+
+//Power over squared distance, clamped so points inside the node do not blow up, times a bound
+//on the cosine at the receiver over every direction into the bounding sphere of the node
+float LightTree::importance(const Node& node, const Vector3& position, const Vector3& normal) const
+{
+	const Vector3 center = (node.box.min + node.box.max) * 0.5f;
+	const Vector3 half_extent = (node.box.max - node.box.min) * 0.5f;
+	const Vector3 to_center = center - position;
+	const float distance_squared = to_center.dot(to_center);
+	const float radius_squared = half_extent.dot(half_extent);
+
+	float cos_bound = 1.f;
+	if (normal.dot(normal) > 0.f && distance_squared > radius_squared)
+	{
+		const float cos_theta = normal.dot(to_center) / sqrtf(distance_squared);
+		const float sin_u = sqrtf(radius_squared / distance_squared);
+		const float cos_u = sqrtf(1.f - radius_squared / distance_squared);
+
+		//Cosine of the angle to the nearest direction inside the cone, when the normal is outside it
+		if (cos_theta < cos_u)
+		{
+			const float sin_theta = sqrtf(fmaxf(0.f, 1.f - cos_theta * cos_theta));
+			cos_bound = cos_theta * cos_u + sin_theta * sin_u;
+			if (cos_bound <= 0.f)
+				return 0.f;
+		}
+	}
+
+	return node.power * cos_bound / fmaxf(distance_squared, radius_squared);
+}
+
+int LightTree::sample(const Vector3& position, const Vector3& normal, float random, float& pmf) const
+{
+	if (nodes.empty())
+		return -1;
+
+	pmf = 1.f;
+	int current = 0;
+	while (!nodes[current].leaf)
+	{
+		const int first = current + 1;
+		const int second = nodes[current].offset;
+		const float importance_first = importance(nodes[first], position, normal);
+		const float importance_second = importance(nodes[second], position, normal);
+		const float total = importance_first + importance_second;
+		if (total <= 0.f)
+			return -1;
+
+		//The random number is rescaled at each level so one number drives the whole descent
+		const float p_first = importance_first / total;
+		if (random < p_first)
+		{
+			random = random / p_first;
+			pmf *= p_first;
+			current = first;
+		}
+		else
+		{
+			random = (random - p_first) / (1.f - p_first);
+			pmf *= 1.f - p_first;
+			current = second;
+		}
+		random = fminf(random, 0.99999994f);
+	}
+	return nodes[current].offset;
+}
+
+float LightTree::pmf(int light, const Vector3& position, const Vector3& normal) const
+{
+	if (light < 0 || light >= int(leaf_of_light.size()))
+		return 0.f;
+
+	float pmf = 1.f;
+	int current = leaf_of_light[light];
+	while (nodes[current].parent >= 0)
+	{
+		const int parent = nodes[current].parent;
+		const int first = parent + 1;
+		const int second = nodes[parent].offset;
+		const float importance_first = importance(nodes[first], position, normal);
+		const float importance_second = importance(nodes[second], position, normal);
+		const float total = importance_first + importance_second;
+		if (total <= 0.f)
+			return 0.f;
+
+		pmf *= (current == first ? importance_first : importance_second) / total;
+		current = parent;
+	}
+	return pmf;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "AABB.h"
+#include "Vector3.h"
+#include "Light.h"
+
+/**
+ * Binary hierarchy over emitters for picking a light with probability proportional
+ * to an estimate of its contribution at a shading point. Every node bounds the
+ * positions and total power of the lights below it, so a pick descends one path
+ * from the root and costs the depth of the tree regardless of the number of lights.
+ */
+class LightTree
+{
+public:
+	struct Node
+	{
+		AABB box;
+		//Total power of the lights below the node
+		float power;
+		//Leaf: index of the light. Interior: index of the second child, the first child follows the node.
+		int offset;
+		//Parent node, -1 for the root
+		int parent;
+		bool leaf;
+	};
+
+	std::vector<Node> nodes;
+	//Leaf node of every light
+	std::vector<int> leaf_of_light;
+
+	//Builds the tree over lights with the given bounds and power
+	void build(const std::vector<AABB>& bounds, const std::vector<float>& power);
+	void build(const std::vector<Light>& lights);
+
+	bool empty() const
+	{
+		return nodes.empty();
+	}
+
+	//Picks a light for a point at position with unit surface normal, or a zero normal to ignore orientation.
+	//Returns -1 when no light can reach the point, otherwise pmf receives the probability of the pick.
+	int sample(const Vector3& position, const Vector3& normal, float random, float& pmf) const;
+
+	//Probability that sample picks light for the same position and normal
+	float pmf(int light, const Vector3& position, const Vector3& normal) const;
+
+private:
+	int build(std::vector<int>& indices, int begin, int end, int parent, const std::vector<AABB>& bounds,
+	          const std::vector<float>& power, const std::vector<Vector3>& centroids);
+	float importance(const Node& node, const Vector3& position, const Vector3& normal) const;
+};
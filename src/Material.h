@@ -6,14 +6,40 @@
 #include "Ray.h"
 #include "Texture.h"
 #include "Globals.h"
+#include "ShadingBatch.h"
+#include "Scene.h"
+#include "Sampling.h"
+#include "PathGuide.h"
 
 inline Vector3 reflect(const Vector3& v, const Vector3& n);
 inline bool refract(const Vector3& v, const Vector3& n, float ni_over_nt, Vector3& refracted);
 inline float schlick(float cosine, float ref_idx);
 
+//Multiple importance sampling weight for a sample drawn with pdf_a that could also have come from pdf_b
+inline float power_heuristic(float pdf_a, float pdf_b)
+{
+	const float a2 = pdf_a * pdf_a;
+	const float b2 = pdf_b * pdf_b;
+	return a2 + b2 > 0.f ? a2 / (a2 + b2) : 0.f;
+}
+
+//Materials that have a batch shading kernel, used to bin hits so each kernel
+//runs over a homogeneous set. Generic materials are shaded through the virtual interface.
+enum class MaterialType
+{
+	Generic,
+	Lambertian,
+	Metal,
+	Dialectric,
+	DiffuseLight,
+	Count
+};
+
 class Material
 {
 public:
+	MaterialType type = MaterialType::Generic;
+
 	virtual ~Material() = default;
 	virtual bool scatter(const Ray& ray_in, const HitRecord& rec, Vector3& attenuation,
 	                     Ray& scattered_ray_out) const = 0;
@@ -22,10 +48,25 @@ public:
 
 	virtual Vector3 emitted(const Ray& ray, const HitRecord& rec) const { return Vector3::ZERO; }
 
+	//Emissive materials make the primitives using them sampleable lights
+	virtual bool isEmissive() const { return false; }
+
+	//Whether every ray leaving the surface goes in one of at most two fixed directions,
+	//guide buffers look through such surfaces to the first one that is not
+	virtual bool isSpecular() const { return false; }
+
+	//Reflectance at rec as written to the albedo guide buffer
+	virtual Vector3 getAlbedo(const HitRecord& rec) const { return Vector3(1); }
+
 	virtual bool reflection(const Ray& ray_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered_ray_out) const
 	{
 		return false;
 	}
+
+	//Adds emission and scatters every hit listed in indices using the virtual interface.
+	//Paths that are absorbed are marked as no longer alive. Random draws made by the
+	//virtual calls come from a stream keyed by the path and bounce.
+	static void shadeGenericBatch(PathBatch& paths, const HitBatch& hits, const int* indices, int count);
 };
 
 class Lambertian : public Material
@@ -35,17 +76,100 @@ public:
 
 	Lambertian(Texture* a) : albedo(a)
 	{
+		type = MaterialType::Lambertian;
+	}
+
+	Vector3 getAlbedo(const HitRecord& rec) const override
+	{
+		return albedo->value(rec.u, rec.v, rec.position);
 	}
 
 	bool scatter(const Ray& ray_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered_ray_out) const override
 	{
-		const Vector3 out_direction = rec.normal + Random::random_in_unit_sphere();	
+		const Vector3 out_direction = Random::random_cosine_direction(rec.normal);
 		scattered_ray_out.time = ray_in.time;
 		scattered_ray_out.origin = rec.position;
 		scattered_ray_out.direction = out_direction;
 		attenuation = albedo->value(rec.u,rec.v, rec.position);
 		return true;
 	}
+
+	//Samples one light directly, weighted against finding it by the bounce that follows.
+	//Once the path guide is trained the bounce follows it or the cosine lobe with equal odds,
+	//and both strategies are weighted by the density of that mixture.
+	static void scatterBatch(PathBatch& paths, const HitBatch& hits, const Scene& scene, const int* indices,
+	                         int count)
+	{
+		const bool guided = g_path_guide && g_path_guide->isTrained();
+		for (int k = 0; k < count; k++)
+		{
+			const int i = indices[k];
+			const Lambertian* mat = static_cast<const Lambertian*>(hits.material[i]);
+			const Vector3 position = hits.getPosition(i);
+			const Vector3 normal = hits.getNormal(i);
+			const Vector3 albedo = mat->albedo->value(hits.u[i], hits.v[i], position);
+			const PathGuide::DirectionalTree* guide = guided ? &g_path_guide->lookup(position) : nullptr;
+
+			LightSample light;
+			if (scene.sampleLight(paths.time[i], position, normal, paths.getSample(i, Sampler::LightSelect),
+			                      paths.getSample(i, Sampler::LightU), paths.getSample(i, Sampler::LightV), light))
+			{
+				const Vector3 to_light = light.position - position;
+				const float distance_squared = to_light.dot(to_light);
+				const float distance = sqrtf(distance_squared);
+				const Vector3 light_dir = to_light / distance;
+				const float cos_surface = normal.dot(light_dir);
+				const float cos_light = fabsf(light.normal.dot(light_dir));
+
+				if (cos_surface > 0.f && cos_light > 0.f &&
+					!scene.occluded(Ray(position, light_dir, paths.time[i]), 0.001f, distance - 0.01f))
+				{
+					const float light_pdf = light.pdf_area * distance_squared / cos_light;
+					const float bsdf_cos = cos_surface / PI;
+					const float bsdf_pdf = guide ? mixPdf(*guide, light_dir, bsdf_cos) : bsdf_cos;
+					const float weight = power_heuristic(light_pdf, bsdf_pdf);
+					paths.addRadiance(i, albedo * light.emitted * (bsdf_cos * weight / light_pdf));
+				}
+			}
+
+			Vector3 out_direction;
+			if (guide && paths.getSample(i, Sampler::BsdfChoice) < PathGuide::GUIDE_FRACTION)
+				out_direction = PathGuide::sample(*guide, paths.getSample(i, Sampler::BsdfU),
+				                                  paths.getSample(i, Sampler::BsdfV));
+			else
+				out_direction = sample_cosine_direction(normal, paths.getSample(i, Sampler::BsdfU),
+				                                        paths.getSample(i, Sampler::BsdfV));
+			const float cosine = normal.dot(out_direction);
+			if (cosine <= 0.f)
+			{
+				paths.alive[i] = 0;
+				continue;
+			}
+
+			const float bsdf_cos = cosine / PI;
+			const float pdf = guide ? mixPdf(*guide, out_direction, bsdf_cos) : bsdf_cos;
+			paths.setRay(i, position, out_direction);
+			paths.attenuate(i, albedo * (bsdf_cos / pdf));
+			paths.bsdf_pdf[i] = pdf;
+			paths.specular[i] = 0;
+			//The light tracer only connects to surfaces the camera sees directly,
+			//photons reach any first diffuse surface behind specular bounces
+			paths.light_traced[i] = !paths.diffuse_seen[i] && (g_photon_mapper || (g_light_tracer && paths.depth[i] == 0));
+			paths.diffuse_seen[i] = 1;
+			paths.vertex_normal_x[i] = normal.x;
+			paths.vertex_normal_y[i] = normal.y;
+			paths.vertex_normal_z[i] = normal.z;
+			if (g_path_guide)
+				paths.addGuideVertex(i, position, out_direction, pdf);
+		}
+	}
+
+private:
+	static float mixPdf(const PathGuide::DirectionalTree& guide, const Vector3& direction, float bsdf_pdf)
+	{
+		return PathGuide::GUIDE_FRACTION * PathGuide::pdf(guide, direction) +
+			(1.f - PathGuide::GUIDE_FRACTION) * bsdf_pdf;
+	}
 };
 
 
@@ -59,6 +183,21 @@ public:
 
 	Dialectric(const Vector3& a, float ri, float blur = 0.f) : albedo(a), ref_idx(ri), blur(blur)
 	{
+		type = MaterialType::Dialectric;
+	}
+
+	bool isSpecular() const override
+	{
+#ifdef DISTRIBUTED_RAYS
+		return blur == 0.f;
+#else
+		return true;
+#endif
+	}
+
+	Vector3 getAlbedo(const HitRecord& rec) const override
+	{
+		return albedo;
 	}
 
 	bool reflection(const Ray& ray_in, const HitRecord& rec, Vector3& attenuation,
@@ -140,6 +279,53 @@ public:
 
 		return true;
 	}
+
+	static void scatterBatch(PathBatch& paths, const HitBatch& hits, const int* indices, int count)
+	{
+		for (int k = 0; k < count; k++)
+		{
+			const int i = indices[k];
+			const Dialectric* mat = static_cast<const Dialectric*>(hits.material[i]);
+			const Vector3 direction(paths.direction_x[i], paths.direction_y[i], paths.direction_z[i]);
+			const Vector3 normal = hits.getNormal(i);
+			const float d_dot_n = direction.dot(normal);
+
+			Vector3 outward_normal;
+			float ni_over_nt;
+			float cosine;
+			if (d_dot_n > 0.0f)
+			{
+				outward_normal = -normal;
+				ni_over_nt = mat->ref_idx;
+				cosine = mat->ref_idx * d_dot_n / direction.length();
+			}
+			else
+			{
+				outward_normal = normal;
+				ni_over_nt = 1.0f / mat->ref_idx;
+				cosine = -d_dot_n / direction.length();
+			}
+
+			Vector3 refracted;
+			const float reflect_prob = refract(direction, outward_normal, ni_over_nt, refracted)
+				                           ? schlick(cosine, mat->ref_idx)
+				                           : 1.0f;
+
+			if (paths.getSample(i, Sampler::BsdfChoice) < reflect_prob)
+			{
+				paths.setRay(i, hits.getPosition(i), reflect(direction, normal));
+				paths.attenuate(i, mat->albedo);
+			}
+			else
+			{
+				const Vector3 jitter = sample_uniform_ball(paths.getSample(i, Sampler::BsdfU),
+				                                           paths.getSample(i, Sampler::BsdfV),
+				                                           paths.getSample(i, Sampler::BsdfW));
+				paths.setRay(i, hits.getPosition(i), refracted + mat->blur * jitter);
+			}
+			paths.specular[i] = 1;
+		}
+	}
 };
 
 
@@ -150,6 +336,7 @@ public:
 
 	DiffuseLight(Texture* a) : emit(a)
 	{
+		type = MaterialType::DiffuseLight;
 	}
 
 	bool scatter(const Ray& ray_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered_ray_out) const override
@@ -161,8 +348,67 @@ public:
 	{
 		return emit->value(rec.u, rec.v, rec.position);
 	}
+
+	bool isEmissive() const override { return true; }
+
+	//Lights only emit, so every path that reaches one ends here.
+	//Emission found by a bounce that also sampled lights directly shares its weight with that estimate.
+	static void shadeBatch(PathBatch& paths, const HitBatch& hits, const Scene& scene, const int* indices, int count)
+	{
+		for (int k = 0; k < count; k++)
+		{
+			const int i = indices[k];
+			const DiffuseLight* mat = static_cast<const DiffuseLight*>(hits.material[i]);
+			if (paths.light_traced[i] && paths.specular[i] && hits.primitive[i] >= 0 &&
+				scene.light_of_primitive[hits.primitive[i]] >= 0)
+			{
+				paths.alive[i] = 0;
+				continue;
+			}
+
+			Vector3 emission = mat->emit->value(hits.u[i], hits.v[i], hits.getPosition(i));
+
+			if (!paths.specular[i])
+			{
+				const Vector3 origin(paths.origin_x[i], paths.origin_y[i], paths.origin_z[i]);
+				const Vector3 normal(paths.vertex_normal_x[i], paths.vertex_normal_y[i], paths.vertex_normal_z[i]);
+				const float light_pdf = scene.lightPdf(hits.get(i), origin, normal);
+				emission *= power_heuristic(paths.bsdf_pdf[i], light_pdf);
+			}
+
+			paths.addRadiance(i, emission);
+			paths.alive[i] = 0;
+		}
+	}
 };
 
+inline void Material::shadeGenericBatch(PathBatch& paths, const HitBatch& hits, const int* indices, int count)
+{
+	for (int k = 0; k < count; k++)
+	{
+		const int i = indices[k];
+		const Ray ray_in = paths.getRay(i);
+		const HitRecord rec = hits.get(i);
+
+		Random::setStream(uint32_t(paths.pixel[i]), paths.sample[i],
+		                  uint32_t(paths.first_dimension[i] + paths.depth[i] * Sampler::BounceDimensions));
+
+		paths.addRadiance(i, rec.mat_ptr->emitted(ray_in, rec));
+
+		Ray ray_out;
+		ray_out.time = ray_in.time;
+		Vector3 attenuation;
+		if (rec.mat_ptr->scatter(ray_in, rec, attenuation, ray_out))
+		{
+			paths.setRay(i, ray_out);
+			paths.attenuate(i, attenuation);
+			paths.specular[i] = 1;
+		}
+		else
+			paths.alive[i] = 0;
+	}
+}
+
 //Reflect Equation
 Vector3 reflect(const Vector3& v, const Vector3& n)
 {
@@ -10,10 +10,25 @@ public:
 
 	Metal(const Vector3& a, float f) : albedo(a)
 	{
+		type = MaterialType::Metal;
 		if (f < 1) fuzz = f;
 		else fuzz = 1;
 	}
 
+	bool isSpecular() const override
+	{
+#ifdef DISTRIBUTED_RAYS
+		return fuzz == 0.f;
+#else
+		return true;
+#endif
+	}
+
+	Vector3 getAlbedo(const HitRecord& rec) const override
+	{
+		return albedo;
+	}
+
 	bool scatter(const Ray& ray_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered_ray_out) const override
 	{
 		scattered_ray_out.time = ray_in.time;
@@ -35,4 +50,33 @@ public:
 		return (scattered_ray_out.direction.dot(rec.normal) > 0);
 	}
 
+	static void scatterBatch(PathBatch& paths, const HitBatch& hits, const int* indices, int count)
+	{
+		for (int k = 0; k < count; k++)
+		{
+			const int i = indices[k];
+			const Metal* mat = static_cast<const Metal*>(hits.material[i]);
+			const Vector3 direction(paths.direction_x[i], paths.direction_y[i], paths.direction_z[i]);
+			const Vector3 normal = hits.getNormal(i);
+			const Vector3 reflected = reflect(direction.getNormalized(), normal);
+
+#ifdef DISTRIBUTED_RAYS
+			const Vector3 out_direction = reflected + mat->fuzz * sample_uniform_ball(
+				paths.getSample(i, Sampler::BsdfU), paths.getSample(i, Sampler::BsdfV),
+				paths.getSample(i, Sampler::BsdfW));
+#else
+			const Vector3 out_direction = reflected;
+#endif
+			//Rays scattered below the surface are absorbed
+			if (out_direction.dot(normal) <= 0)
+			{
+				paths.alive[i] = 0;
+				continue;
+			}
+
+			paths.setRay(i, hits.getPosition(i) + normal * 0.001f, out_direction);
+			paths.attenuate(i, mat->albedo);
+			paths.specular[i] = 1;
+		}
+	}
 };
@@ -26,13 +26,25 @@ public:
 
 	bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const override
 	{
-		Vector3 center = getCenter(ray.time);
+		return intersect(MovingSphereData{center0, center1, time0, time1, radius, mat_ptr}, ray, t_min, t_max,
+		                 hit_record);
+	}
+
+	static Vector3 getCenter(const MovingSphereData& sphere, float time)
+	{
+		return sphere.center0 + ((time - sphere.time0) / (sphere.time1 - sphere.time0)) * (sphere.center1 - sphere.center0);
+	}
+
+	static bool intersect(const MovingSphereData& sphere, const Ray& ray, float t_min, float t_max,
+	                      HitRecord& hit_record)
+	{
+		Vector3 center = getCenter(sphere, ray.time);
 
 		Vector3 oc = ray.origin - center;
 
 		float a = ray.direction.dot(ray.direction);
 		float b = ray.direction.dot(oc);
-		float c = oc.dot(oc) - radius * radius;
+		float c = oc.dot(oc) - sphere.radius * sphere.radius;
 
 		//Use quadratic formula
 		// (-b +- sqrt(b^2 - 4ac)) / 2a
@@ -53,8 +65,8 @@ public:
 			{
 				hit_record.t = t0;
 				hit_record.position = ray.point_at_parameter(t0);
-				hit_record.normal = (hit_record.position - center) / radius;
-				hit_record.mat_ptr = mat_ptr;
+				hit_record.normal = (hit_record.position - center) / sphere.radius;
+				hit_record.mat_ptr = sphere.mat_ptr;
 				float u, v;
 				getSphereUV(hit_record.position - center, u, v);
 				hit_record.u = u;
@@ -67,8 +79,8 @@ public:
 			{
 				hit_record.t = t1;
 				hit_record.position = ray.point_at_parameter(t1);
-				hit_record.normal = (hit_record.position - center) / radius;
-				hit_record.mat_ptr = mat_ptr;
+				hit_record.normal = (hit_record.position - center) / sphere.radius;
+				hit_record.mat_ptr = sphere.mat_ptr;
 				float u, v;
 				getSphereUV(hit_record.position - center, u, v);
 				hit_record.u = u;
@@ -87,4 +99,11 @@ public:
 		b = surrounding_box(box0,box1);
 		return true;
 	}
+
+	void flatten(PrimitiveStore& store) const override
+	{
+		AABB box;
+		bounding_box(store.time0, store.time1, box);
+		store.add(MovingSphereData{center0, center1, time0, time1, radius, mat_ptr}, box);
+	}
 };
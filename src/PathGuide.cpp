@@ -0,0 +1,312 @@
+#include "PathGuide.h"
+#include "ShadingBatch.h"
+#include "Globals.h"
+#include <cmath>
+#include <algorithm>
+
+//Area preserving map from the unit sphere to the unit square, cos(theta) on u and phi on v
+static void direction_to_square(const Vector3& direction, float& u, float& v)
+{
+	const float cos_theta = std::clamp(direction.z, -1.f, 1.f);
+	float phi = atan2f(direction.y, direction.x);
+	if (phi < 0.f)
+		phi += 2.f * PI;
+	u = std::clamp((cos_theta + 1.f) * 0.5f, 0.f, 0.99999994f);
+	v = std::clamp(phi / (2.f * PI), 0.f, 0.99999994f);
+}
+
+static Vector3 square_to_direction(float u, float v)
+{
+	const float cos_theta = 2.f * u - 1.f;
+	const float sin_theta = sqrtf(fmaxf(0.f, 1.f - cos_theta * cos_theta));
+	const float phi = 2.f * PI * v;
+	return Vector3(sin_theta * cosf(phi), sin_theta * sinf(phi), cos_theta);
+}
+
+static const float FIXED_POINT_SCALE = 65536.f;
+
+PathGuide::DirectionalTree::DirectionalTree()
+{
+	nodes.push_back(Node{{0, 0, 0, 0}, {0, 0, 0, 0}});
+}
+
+uint64_t PathGuide::DirectionalTree::total() const
+{
+	const Node& root = nodes[0];
+	return root.sum[0] + root.sum[1] + root.sum[2] + root.sum[3];
+}
+
+PathGuide::PathGuide(const AABB& bounds, size_t memory_budget) : bounds(bounds), memory_budget(memory_budget)
+{
+	spatial.push_back(SpatialNode{0, -1, 0.f});
+	leaves.emplace_back();
+}
+
+int PathGuide::leafOf(const Vector3& position) const
+{
+	int node = 0;
+	while (spatial[node].axis >= 0)
+		node = spatial[node].index + (position[spatial[node].axis] >= spatial[node].split ? 1 : 0);
+	return spatial[node].index;
+}
+
+const PathGuide::DirectionalTree& PathGuide::lookup(const Vector3& position) const
+{
+	return leaves[leafOf(position)].sampling;
+}
+
+Vector3 PathGuide::sample(const DirectionalTree& tree, float u1, float u2)
+{
+	float x = 0.f, y = 0.f, size = 1.f;
+	int node = 0;
+	while (true)
+	{
+		const DirectionalTree::Node& n = tree.nodes[node];
+		const double total = double(n.sum[0] + n.sum[1] + n.sum[2] + n.sum[3]);
+		if (total <= 0.0)
+			break;
+
+		//Column first, then the quadrant within the column, rescaling the sample values each time
+		const double left = double(n.sum[0] + n.sum[2]);
+		const float p_left = float(left / total);
+		int qx = 0;
+		if (u1 < p_left)
+			u1 = u1 / p_left;
+		else
+		{
+			u1 = (u1 - p_left) / (1.f - p_left);
+			qx = 1;
+		}
+
+		const double column = double(n.sum[qx] + n.sum[qx + 2]);
+		const float p_bottom = float(double(n.sum[qx]) / column);
+		int qy = 0;
+		if (u2 < p_bottom)
+			u2 = u2 / p_bottom;
+		else
+		{
+			u2 = (u2 - p_bottom) / (1.f - p_bottom);
+			qy = 1;
+		}
+
+		u1 = fminf(u1, 0.99999994f);
+		u2 = fminf(u2, 0.99999994f);
+		size *= 0.5f;
+		x += float(qx) * size;
+		y += float(qy) * size;
+
+		node = n.child[qx + 2 * qy];
+		if (node == 0)
+			break;
+	}
+	return square_to_direction(x + u1 * size, y + u2 * size);
+}
+
+float PathGuide::pdf(const DirectionalTree& tree, const Vector3& direction)
+{
+	float u, v;
+	direction_to_square(direction, u, v);
+
+	float density = 1.f;
+	int node = 0;
+	while (true)
+	{
+		const DirectionalTree::Node& n = tree.nodes[node];
+		const uint64_t total = n.sum[0] + n.sum[1] + n.sum[2] + n.sum[3];
+		if (total == 0)
+			break;
+
+		const int qx = u >= 0.5f ? 1 : 0;
+		const int qy = v >= 0.5f ? 1 : 0;
+		const int q = qx + 2 * qy;
+		density *= float(4.0 * double(n.sum[q]) / double(total));
+		u = 2.f * u - float(qx);
+		v = 2.f * v - float(qy);
+
+		node = n.child[q];
+		if (node == 0)
+			break;
+	}
+	return density / (4.f * PI);
+}
+
+void PathGuide::splat(DirectionalTree& tree, const Vector3& direction, float value) const
+{
+	const uint64_t amount = uint64_t(value * FIXED_POINT_SCALE);
+	if (amount == 0)
+		return;
+
+	float u, v;
+	direction_to_square(direction, u, v);
+	int node = 0;
+	while (true)
+	{
+		const int qx = u >= 0.5f ? 1 : 0;
+		const int qy = v >= 0.5f ? 1 : 0;
+		const int q = qx + 2 * qy;
+		tree.nodes[node].sum[q] += amount;
+		u = 2.f * u - float(qx);
+		v = 2.f * v - float(qy);
+
+		node = tree.nodes[node].child[q];
+		if (node == 0)
+			break;
+	}
+}
+
+void PathGuide::record(const PathBatch& paths)
+{
+	struct Splat
+	{
+		int leaf;
+		Vector3 direction;
+		float value;
+	};
+	std::vector<Splat> splats;
+
+	for (int i = 0; i < paths.size; i++)
+	{
+		const Vector3 radiance = paths.getRadiance(i);
+		for (int k = 0; k < paths.guide_vertex_count[i]; k++)
+		{
+			const GuideVertex& vertex = paths.guide_vertices[i * PathBatch::GUIDE_VERTICES + k];
+
+			//Light gathered after the vertex divided by the throughput up to it is the incident radiance
+			const Vector3 gathered = radiance - vertex.radiance;
+			const Vector3 incident(vertex.throughput.r > 0.f ? gathered.r / vertex.throughput.r : 0.f,
+			                       vertex.throughput.g > 0.f ? gathered.g / vertex.throughput.g : 0.f,
+			                       vertex.throughput.b > 0.f ? gathered.b / vertex.throughput.b : 0.f);
+			const float luminance = 0.2126f * incident.r + 0.7152f * incident.g + 0.0722f * incident.b;
+
+			//Radiance over pdf estimates the integral of the incident light over each quadrant
+			const float value = vertex.pdf > 0.f ? std::clamp(luminance / vertex.pdf, 0.f, 1e6f) : 0.f;
+			splats.push_back(Splat{leafOf(vertex.position), vertex.direction, value});
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(record_mutex);
+	for (const Splat& s : splats)
+	{
+		splat(leaves[s.leaf].building, s.direction, s.value);
+		leaves[s.leaf].records++;
+	}
+}
+
+void PathGuide::endFrame()
+{
+	if (++frames_in_iteration < (1 << iteration))
+		return;
+
+	//Records per leaf grow with the iteration length, so the split threshold does too
+	const float threshold = float(SPATIAL_THRESHOLD) * sqrtf(float(1 << iteration));
+	if (getMemoryUsage() < memory_budget / 2)
+		splitLeaves(0, bounds, 0.f, threshold);
+
+	const size_t node_size = sizeof(DirectionalTree::Node);
+	const size_t spatial_size = spatial.size() * sizeof(SpatialNode);
+	const size_t available = memory_budget > spatial_size ? memory_budget - spatial_size : 0;
+	refine(int(available / node_size / 2 / leaves.size()));
+
+	for (Leaf& leaf : leaves)
+		leaf.records = 0;
+	frames_in_iteration = 0;
+	if (iteration < 20)
+		iteration++;
+}
+
+//Splits every leaf whose records exceed threshold at the middle of its largest extent.
+//The children share the records evenly, so a leaf keeps splitting until they fall below it.
+void PathGuide::splitLeaves(int node, const AABB& box, float records, float threshold)
+{
+	if (spatial[node].axis >= 0)
+	{
+		const int axis = spatial[node].axis;
+		const float split = spatial[node].split;
+		AABB first = box, second = box;
+		first.max[axis] = split;
+		second.min[axis] = split;
+		const int child = spatial[node].index;
+		splitLeaves(child, first, 0.f, threshold);
+		splitLeaves(child + 1, second, 0.f, threshold);
+		return;
+	}
+
+	const int leaf = spatial[node].index;
+	if (records == 0.f)
+		records = float(leaves[leaf].records);
+	if (records <= threshold || getMemoryUsage() >= memory_budget / 2)
+		return;
+
+	const int axis = (box.max - box.min).getLargestComponentIndex();
+	const float split = (box.min[axis] + box.max[axis]) * 0.5f;
+
+	const int second_leaf = int(leaves.size());
+	leaves.push_back(leaves[leaf]);
+
+	const int child = int(spatial.size());
+	spatial.push_back(SpatialNode{leaf, -1, 0.f});
+	spatial.push_back(SpatialNode{second_leaf, -1, 0.f});
+	spatial[node] = SpatialNode{child, axis, split};
+
+	AABB first = box, second = box;
+	first.max[axis] = split;
+	second.min[axis] = split;
+	splitLeaves(child, first, records * 0.5f, threshold);
+	splitLeaves(child + 1, second, records * 0.5f, threshold);
+}
+
+//The building trees become the sampling trees, and new building trees subdivide where they hold energy
+void PathGuide::refine(int max_nodes_per_tree)
+{
+	for (Leaf& leaf : leaves)
+	{
+		if (leaf.building.total() > 0)
+			leaf.sampling = leaf.building;
+
+		const DirectionalTree& source = leaf.sampling;
+		DirectionalTree refined;
+		const uint64_t total = source.total();
+		if (total > 0)
+		{
+			refined.nodes.clear();
+			int budget = max_nodes_per_tree - 1;
+			refineNode(source, 0, source.nodes[0].sum, total, 1, budget, refined);
+		}
+		leaf.building = refined;
+	}
+}
+
+int PathGuide::refineNode(const DirectionalTree& old_tree, int old_node, const uint64_t* sums, uint64_t total,
+                          int depth, int& budget, DirectionalTree& out)
+{
+	const int index = int(out.nodes.size());
+	out.nodes.push_back(DirectionalTree::Node{{0, 0, 0, 0}, {0, 0, 0, 0}});
+
+	for (int q = 0; q < 4; q++)
+	{
+		const float fraction = float(double(sums[q]) / double(total));
+		if (fraction <= SUBDIVISION_THRESHOLD || depth >= MAX_DIRECTIONAL_DEPTH || budget <= 0)
+			continue;
+		budget--;
+
+		//Energy of quadrants that were leaves is spread evenly over the new children
+		const int old_child = old_node >= 0 ? old_tree.nodes[old_node].child[q] : 0;
+		uint64_t child_sums[4] = {sums[q] / 4, sums[q] / 4, sums[q] / 4, sums[q] / 4};
+		if (old_child != 0)
+			for (int c = 0; c < 4; c++)
+				child_sums[c] = old_tree.nodes[old_child].sum[c];
+
+		const int child = refineNode(old_tree, old_child != 0 ? old_child : -1, child_sums, total, depth + 1,
+		                             budget, out);
+		out.nodes[index].child[q] = child;
+	}
+	return index;
+}
+
+size_t PathGuide::getMemoryUsage() const
+{
+	size_t nodes = 0;
+	for (const Leaf& leaf : leaves)
+		nodes += leaf.sampling.nodes.size() + leaf.building.nodes.size();
+	return nodes * sizeof(DirectionalTree::Node) + spatial.size() * sizeof(SpatialNode) + leaves.size() * sizeof(Leaf);
+}
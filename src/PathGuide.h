@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "AABB.h"
+#include "Vector3.h"
+
+struct PathBatch;
+
+/**
+ * Online path guiding with a spatial-directional tree (Mueller et al. 2017).
+ * A binary tree over space holds a pair of directional quad-trees in every leaf.
+ * Directions are mapped to the square by cos(theta) and phi, which preserves area.
+ * Finished paths splat their incident radiance into the building trees. At the end of
+ * each training iteration the building trees become the sampling trees, directional
+ * trees are refined where the energy concentrates and crowded spatial leaves split.
+ * Iterations double in length so later distributions are trained on more paths.
+ */
+class PathGuide
+{
+public:
+	//Probability of following the learned distribution instead of the BSDF
+	static constexpr float GUIDE_FRACTION = 0.5f;
+	//Share of the energy of a directional tree above which a quadrant is subdivided
+	static constexpr float SUBDIVISION_THRESHOLD = 0.01f;
+	static const int MAX_DIRECTIONAL_DEPTH = 16;
+	//Spatial leaves split once they gathered more than this times sqrt(2^iteration) records
+	static const int SPATIAL_THRESHOLD = 4000;
+
+	struct DirectionalTree
+	{
+		struct Node
+		{
+			//Energy of each quadrant in 16.16 fixed point, integers add up the same in any order
+			uint64_t sum[4];
+			//Child node of each quadrant, 0 for a leaf
+			int child[4];
+		};
+
+		std::vector<Node> nodes;
+
+		DirectionalTree();
+		uint64_t total() const;
+	};
+
+	struct SpatialNode
+	{
+		//Leaf: index of the directional trees. Interior: index of the first child, the second follows it.
+		int index;
+		//Split axis, -1 for leaves
+		int axis;
+		float split;
+	};
+
+	PathGuide(const AABB& bounds, size_t memory_budget);
+
+	//Whether a learned distribution exists yet
+	bool isTrained() const
+	{
+		return iteration > 0;
+	}
+
+	//Sampling tree of the spatial leaf holding position
+	const DirectionalTree& lookup(const Vector3& position) const;
+
+	//Direction drawn from tree with sample values u1, u2
+	static Vector3 sample(const DirectionalTree& tree, float u1, float u2);
+	//Solid angle density with which sample picks direction
+	static float pdf(const DirectionalTree& tree, const Vector3& direction);
+
+	//Splats the incident radiance found after each recorded vertex of the finished paths. Thread safe.
+	void record(const PathBatch& paths);
+
+	//Counts a finished frame, at the end of a training iteration refines the trees from the records
+	void endFrame();
+
+	size_t getMemoryUsage() const;
+
+private:
+	struct Leaf
+	{
+		DirectionalTree sampling;
+		DirectionalTree building;
+		int records = 0;
+	};
+
+	AABB bounds;
+	size_t memory_budget;
+
+	std::vector<SpatialNode> spatial;
+	std::vector<Leaf> leaves;
+
+	int iteration = 0;
+	int frames_in_iteration = 0;
+	std::mutex record_mutex;
+
+	int leafOf(const Vector3& position) const;
+	void splat(DirectionalTree& tree, const Vector3& direction, float value) const;
+	void splitLeaves(int node, const AABB& box, float records, float threshold);
+	void refine(int max_nodes_per_tree);
+
+	static int refineNode(const DirectionalTree& old_tree, int old_node, const uint64_t* sums, uint64_t total,
+	                      int depth, int& budget, DirectionalTree& out);
+};
@@ -0,0 +1,298 @@
+#include "PhotonMapper.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "Material.h"
+#include "LightTracer.h"
+#include "Random.h"
+#include <cfloat>
+#include <cmath>
+
+//Stream dimensions of the camera and photon paths, apart from the blocks other paths use
+static const uint32_t VISIBLE_STREAM = 0x90000000U;
+static const uint32_t PHOTON_STREAM = 0xA0000000U;
+static const uint32_t PASS_STREAM = 0xB0000000U;
+
+void PhotonMapper::resize(int width, int height, float scene_diagonal)
+{
+	this->width = width;
+	this->height = height;
+	initial_radius = INITIAL_RADIUS * scene_diagonal;
+	visible.resize(size_t(width) * height);
+	pixels.resize(size_t(width) * height);
+
+	photons.resize(PHOTONS_PER_PASS);
+	stored.resize(PHOTONS_PER_PASS);
+	photon_bucket.resize(PHOTONS_PER_PASS);
+	bucket_photons.resize(PHOTONS_PER_PASS);
+	sorted_photons.resize(PHOTONS_PER_PASS);
+
+	//Twice as many buckets as photons keeps collisions rare
+	bucket_count = 1;
+	while (bucket_count < 2 * PHOTONS_PER_PASS)
+		bucket_count <<= 1;
+	bucket_start.resize(size_t(bucket_count) + 1);
+	bucket_fill.reset(new std::atomic<int>[bucket_count]);
+	reset();
+}
+
+void PhotonMapper::reset()
+{
+	for (PixelState& p : pixels)
+	{
+		p.count = 0.f;
+		p.radius = initial_radius;
+		p.tau = Vector3(0.f);
+	}
+	photons_emitted = 0;
+}
+
+void PhotonMapper::trace(const Scene& scene, const Camera& camera)
+{
+	const int pixel_count = width * height;
+
+	//Visible points and photons of a pass share one shutter time, or photons on moving objects would
+	//be gathered where the object is at another time
+	Random::setStream(0, pass, PASS_STREAM);
+	time_u = Random::randf(0.f, 1.f);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int pixel = 0; pixel < pixel_count; pixel++)
+		findVisiblePoint(scene, camera, pixel);
+
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < PHOTONS_PER_PASS; i++)
+		shootPhoton(scene, camera, i);
+	photons_emitted += PHOTONS_PER_PASS;
+
+	buildGrid();
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for (int pixel = 0; pixel < pixel_count; pixel++)
+		gather(pixel);
+
+	pass++;
+}
+
+//Follows a jittered camera ray through specular bounces to the first diffuse surface.
+//Chains are followed as deep as camera paths go, or their caustics would be missing from both halves.
+void PhotonMapper::findVisiblePoint(const Scene& scene, const Camera& camera, int pixel)
+{
+	VisiblePoint& vp = visible[pixel];
+	vp.valid = false;
+
+	Random::setStream(uint32_t(pixel), pass, VISIBLE_STREAM);
+	float u[4];
+	Random::fill(u, 4);
+
+	const int x = pixel % width;
+	const int y = height - 1 - pixel / width;
+	Ray ray = camera.getRay((float(x) + u[0]) / float(width), (float(y) + u[1]) / float(height), u[2], u[3], time_u);
+	ray.direction = ray.direction.getNormalized();
+	Vector3 throughput(1.f);
+
+	for (int bounce = 0; bounce < MAX_RAY_DEPTH; bounce++)
+	{
+		HitRecord rec;
+		if (!scene.hit(ray, 0.001f, FLT_MAX, rec) || rec.mat_ptr->type == MaterialType::DiffuseLight)
+			return;
+
+		if (rec.mat_ptr->type == MaterialType::Lambertian)
+		{
+			const Lambertian* mat = static_cast<const Lambertian*>(rec.mat_ptr);
+			vp.position = rec.position;
+			vp.normal = rec.normal;
+			vp.outgoing = -ray.direction;
+			vp.weight = throughput * mat->albedo->value(rec.u, rec.v, rec.position) * (1.f / PI);
+			vp.valid = true;
+			return;
+		}
+
+		Vector3 attenuation;
+		Ray scattered;
+		if (!rec.mat_ptr->scatter(ray, rec, attenuation, scattered))
+			return;
+		throughput = throughput * attenuation;
+		ray = Ray(scattered.origin, scattered.direction.getNormalized(), ray.time);
+	}
+}
+
+//Follows a photon through specular bounces and stores it on the first diffuse surface after at least one
+void PhotonMapper::shootPhoton(const Scene& scene, const Camera& camera, int index)
+{
+	stored[index] = 0;
+
+	Random::setStream(uint32_t(index), pass, PHOTON_STREAM);
+	float u[5];
+	Random::fill(u, 5);
+
+	const float time = camera.time0 + time_u * (camera.time1 - camera.time0);
+	Ray ray;
+	Vector3 power;
+	if (!LightTracer::startPath(scene, time, u, ray, power))
+		return;
+
+	for (int bounce = 0; bounce < MAX_RAY_DEPTH; bounce++)
+	{
+		HitRecord rec;
+		if (!scene.hit(ray, 0.001f, FLT_MAX, rec) || rec.mat_ptr->type == MaterialType::DiffuseLight)
+			return;
+
+		if (rec.mat_ptr->type == MaterialType::Lambertian)
+		{
+			if (bounce > 0)
+			{
+				photons[index] = Photon{rec.position, ray.direction, power};
+				stored[index] = 1;
+			}
+			return;
+		}
+
+		Vector3 attenuation;
+		Ray scattered;
+		if (!rec.mat_ptr->scatter(ray, rec, attenuation, scattered))
+			return;
+		power = power * attenuation;
+		ray = Ray(scattered.origin, scattered.direction.getNormalized(), time);
+	}
+}
+
+void PhotonMapper::cellOf(const Vector3& position, int& x, int& y, int& z) const
+{
+	x = int(floorf(position.x / cell_size));
+	y = int(floorf(position.y / cell_size));
+	z = int(floorf(position.z / cell_size));
+}
+
+uint64_t PhotonMapper::cellKey(int x, int y, int z)
+{
+	//21 bits per axis, cells that alias are millions of cells apart and fail the radius test
+	return uint64_t(uint32_t(x) & 0x1FFFFFU) << 42 | uint64_t(uint32_t(y) & 0x1FFFFFU) << 21 | uint64_t(uint32_t(z) & 0x1FFFFFU);
+}
+
+int PhotonMapper::bucketOf(int x, int y, int z) const
+{
+	const uint32_t h = uint32_t(x) * 73856093U ^ uint32_t(y) * 19349663U ^ uint32_t(z) * 83492791U;
+	return int(h & uint32_t(bucket_count - 1));
+}
+
+//Counting sort of the stored photons by bucket. Counts and insertion cursors are atomic,
+//and each bucket is sorted afterwards so the order never depends on the threads.
+void PhotonMapper::buildGrid()
+{
+	//Only pixels that have gathered photons decide the cell size, the rest are clamped to it in gather
+	float max_radius = 0.f;
+	const int pixel_count = width * height;
+	for (int pixel = 0; pixel < pixel_count; pixel++)
+	{
+		const PixelState& p = pixels[pixel];
+		if (visible[pixel].valid && p.count > 0.f)
+			max_radius = p.radius > max_radius ? p.radius : max_radius;
+	}
+	cell_size = 2.f * (max_radius > 0.f ? max_radius : initial_radius);
+
+#pragma omp parallel for
+	for (int h = 0; h < bucket_count; h++)
+		bucket_fill[h].store(0, std::memory_order_relaxed);
+
+#pragma omp parallel for
+	for (int i = 0; i < PHOTONS_PER_PASS; i++)
+	{
+		if (!stored[i])
+			continue;
+		int x, y, z;
+		cellOf(photons[i].position, x, y, z);
+		photons[i].cell = cellKey(x, y, z);
+		photon_bucket[i] = bucketOf(x, y, z);
+		bucket_fill[photon_bucket[i]].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bucket_start[0] = 0;
+	for (int h = 0; h < bucket_count; h++)
+	{
+		const int count = bucket_fill[h].load(std::memory_order_relaxed);
+		bucket_fill[h].store(bucket_start[h], std::memory_order_relaxed);
+		bucket_start[h + 1] = bucket_start[h] + count;
+	}
+
+#pragma omp parallel for
+	for (int i = 0; i < PHOTONS_PER_PASS; i++)
+		if (stored[i])
+			bucket_photons[bucket_fill[photon_bucket[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int h = 0; h < bucket_count; h++)
+	{
+		for (int a = bucket_start[h] + 1; a < bucket_start[h + 1]; a++)
+		{
+			const int photon = bucket_photons[a];
+			int b = a;
+			for (; b > bucket_start[h] && bucket_photons[b - 1] > photon; b--)
+				bucket_photons[b] = bucket_photons[b - 1];
+			bucket_photons[b] = photon;
+		}
+	}
+
+	//The records themselves are moved into bucket order, so gathering reads each bucket front to back
+#pragma omp parallel for
+	for (int k = 0; k < bucket_start[bucket_count]; k++)
+		sorted_photons[k] = photons[bucket_photons[k]];
+}
+
+//Adds the photons within the radius of the visible point and shrinks the radius by their count
+void PhotonMapper::gather(int pixel)
+{
+	const VisiblePoint& vp = visible[pixel];
+	if (!vp.valid)
+		return;
+
+	PixelState& state = pixels[pixel];
+	//A pixel that never found a photon is in the same state as if it had started with a smaller radius,
+	//so it takes one that fits the grid
+	if (state.count == 0.f && state.radius > 0.5f * cell_size)
+		state.radius = 0.5f * cell_size;
+	const float radius_squared = state.radius * state.radius;
+	const float facing = vp.outgoing.dot(vp.normal);
+
+	//The radius is at most half a cell, so the sphere only reaches the neighbours on the nearer side
+	int cell[3];
+	cellOf(vp.position, cell[0], cell[1], cell[2]);
+	int neighbour[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float inside = vp.position[axis] / cell_size - float(cell[axis]);
+		neighbour[axis] = inside < 0.5f ? cell[axis] - 1 : cell[axis] + 1;
+	}
+
+	Vector3 flux(0.f);
+	int found = 0;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const int x = corner & 1 ? neighbour[0] : cell[0];
+		const int y = corner & 2 ? neighbour[1] : cell[1];
+		const int z = corner & 4 ? neighbour[2] : cell[2];
+		const int h = bucketOf(x, y, z);
+		const uint64_t key = cellKey(x, y, z);
+		for (int k = bucket_start[h]; k < bucket_start[h + 1]; k++)
+		{
+			const Photon& photon = sorted_photons[k];
+			//Buckets are shared by colliding cells, each photon is counted from its own cell only
+			if (photon.cell != key)
+				continue;
+
+			const Vector3 offset = photon.position - vp.position;
+			if (offset.dot(offset) > radius_squared || photon.direction.dot(vp.normal) * facing >= 0.f)
+				continue;
+			flux += photon.power;
+			found++;
+		}
+	}
+
+	if (found == 0)
+		return;
+
+	const float count = state.count + ALPHA * float(found);
+	const float shrink = count / (state.count + float(found));
+	state.tau = (state.tau + vp.weight * flux) * shrink;
+	state.radius *= sqrtf(shrink);
+	state.count = count;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include "Vector3.h"
+#include "Globals.h"
+
+class Scene;
+class Camera;
+
+/**
+ * Stochastic progressive photon mapping for caustics (Hachisuka and Jensen 2009).
+ * Every pass finds one visible point per pixel, the first diffuse surface behind any
+ * specular bounces, and shoots photons that are stored where they first reach a diffuse
+ * surface after at least one specular bounce. Each pixel gathers the photons within
+ * its radius, which shrinks as photons accumulate so the estimate converges.
+ * The path tracer drops exactly these paths, including the specular-diffuse-specular
+ * ones it could never sample, so both halves add up to the full image.
+ * Photons are kept in flat arrays sorted by the hash of their grid cell, built in parallel.
+ */
+class PhotonMapper
+{
+public:
+	//Photons shot per pass
+	static const int PHOTONS_PER_PASS = 1 << 16;
+	//Fraction of the new photons a pixel keeps in its count, controls how fast radii shrink
+	static constexpr float ALPHA = 0.7f;
+	//Starting radius as a fraction of the scene diagonal
+	static constexpr float INITIAL_RADIUS = 0.005f;
+
+	void resize(int width, int height, float scene_diagonal);
+
+	//Forgets every estimate, must be called whenever the camera moves
+	void reset();
+
+	//Runs a pass: visible points, photons, grid and gather
+	void trace(const Scene& scene, const Camera& camera);
+
+	//Caustic radiance estimate of pixel
+	Vector3 getRadiance(int pixel) const
+	{
+		if (photons_emitted == 0)
+			return Vector3(0.f);
+		const PixelState& p = pixels[pixel];
+		return p.tau * float(1.0 / (double(PI) * p.radius * p.radius * double(photons_emitted)));
+	}
+
+private:
+	struct Photon
+	{
+		Vector3 position;
+		//Direction the photon travelled in
+		Vector3 direction;
+		Vector3 power;
+		//Key of the grid cell, set when the grid is built
+		uint64_t cell;
+	};
+
+	struct VisiblePoint
+	{
+		Vector3 position;
+		Vector3 normal;
+		//Direction back towards the camera
+		Vector3 outgoing;
+		//Camera throughput times the diffuse BSDF
+		Vector3 weight;
+		bool valid;
+	};
+
+	struct PixelState
+	{
+		float count = 0.f;
+		float radius = 0.f;
+		Vector3 tau = Vector3(0.f);
+	};
+
+	int width = 0, height = 0;
+	float initial_radius = 0.f;
+	uint64_t photons_emitted = 0;
+	uint32_t pass = 0;
+	//Shutter position of the current pass in [0, 1)
+	float time_u = 0.f;
+
+	std::vector<VisiblePoint> visible;
+	std::vector<PixelState> pixels;
+
+	//Photons of the current pass, stored[i] says whether photon i reached a diffuse surface
+	std::vector<Photon> photons;
+	std::vector<unsigned char> stored;
+	std::vector<int> photon_bucket;
+	//Photon indices grouped by cell hash while the grid is built
+	std::vector<int> bucket_photons;
+	//Stored photons grouped by cell hash, bucket h owns [bucket_start[h], bucket_start[h + 1])
+	std::vector<Photon> sorted_photons;
+	std::vector<int> bucket_start;
+	//Photon counts and then insertion cursors of the buckets while the grid is built
+	std::unique_ptr<std::atomic<int>[]> bucket_fill;
+	int bucket_count = 0;
+	//Twice the largest radius of the pixels that found photons, so every gather touches at most 8 cells
+	float cell_size = 0.f;
+
+	void findVisiblePoint(const Scene& scene, const Camera& camera, int pixel);
+	void shootPhoton(const Scene& scene, const Camera& camera, int index);
+	void buildGrid();
+	void gather(int pixel);
+
+	void cellOf(const Vector3& position, int& x, int& y, int& z) const;
+	static uint64_t cellKey(int x, int y, int z);
+	int bucketOf(int x, int y, int z) const;
+};
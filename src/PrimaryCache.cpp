@@ -0,0 +1,69 @@
+#include "PrimaryCache.h"
+#include "Hitable.h"
+#include "Metal.h"
+#include "Globals.h"
+#include <cfloat>
+
+void PrimaryCache::resize(int pixel_count)
+{
+	entries.assign(size_t(pixel_count) * JITTER_COUNT, Entry());
+	for (auto& entry : entries)
+		entry.generation = 0;
+}
+
+//Whether scattering off the material gives the same ray every time
+static bool is_perfect_mirror(const Material* material)
+{
+	if (material->type != MaterialType::Metal)
+		return false;
+#ifdef DISTRIBUTED_RAYS
+	return static_cast<const Metal*>(material)->fuzz == 0.f;
+#else
+	return true;
+#endif
+}
+
+void PrimaryCache::fill(Entry& entry, const Ray& camera_ray, unsigned int jitter, const Hitable* world) const
+{
+	entry.generation = generation;
+	entry.jitter = jitter;
+	traceMirrorChain(entry, camera_ray, world);
+}
+
+void PrimaryCache::traceMirrorChain(Entry& entry, const Ray& camera_ray, const Hitable* world)
+{
+	entry.ray = camera_ray;
+	entry.throughput = Vector3(1);
+	entry.radiance = Vector3(0);
+	entry.depth = 0;
+	entry.distance = 0.f;
+	entry.has_vertex = false;
+
+	for (;;)
+	{
+		if (!world->hit(entry.ray, 0.001f, FLT_MAX, entry.hit))
+		{
+			entry.radiance = entry.throughput * AMBIENT_LIGHT;
+			return;
+		}
+		//Camera rays are not normalised
+		entry.distance += entry.hit.t * entry.ray.direction.length();
+
+		if (!is_perfect_mirror(entry.hit.mat_ptr) || entry.depth >= MAX_SPECULAR_PREFIX ||
+			entry.depth >= MAX_RAY_DEPTH || entry.throughput.getMaxComponent() < MIN_THROUGHPUT)
+		{
+			entry.has_vertex = true;
+			return;
+		}
+		const Metal* mirror = static_cast<const Metal*>(entry.hit.mat_ptr);
+
+		//Same reflection as Metal::scatterBatch with no fuzz
+		const Vector3 reflected = reflect(entry.ray.direction.getNormalized(), entry.hit.normal);
+		if (reflected.dot(entry.hit.normal) <= 0)
+			return;
+
+		entry.ray = Ray(entry.hit.position + entry.hit.normal * 0.001f, reflected, entry.ray.time);
+		entry.throughput *= mirror->albedo;
+		entry.depth++;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include "Ray.h"
+#include "HitRecord.h"
+#include "Vector3.h"
+#include "Sampler.h"
+#include "Globals.h"
+
+class Hitable;
+
+/**
+ * Per pixel cache of camera path prefixes, valid while the camera and scene stay put.
+ * Each pixel keeps a small set of jittered primary rays. For each one the cache stores
+ * the first vertex that is not a perfect mirror, together with the attenuation of the
+ * deterministic mirror chain in front of it, so new samples skip straight to it.
+ * Every entry serves REUSE_COUNT samples and is then replaced by a freshly jittered ray,
+ * so pixel area, lens and shutter time are still integrated over as samples accumulate.
+ */
+class PrimaryCache
+{
+public:
+	//Sub-pixel positions cached per pixel, samples cycle through them
+	static const int JITTER_COUNT = 4;
+	//Samples continuing from each cached ray before it is replaced by a new one
+	static const int REUSE_COUNT = 4;
+	//Longest chain of perfect mirror bounces followed before a vertex is cached
+	static const int MAX_SPECULAR_PREFIX = 8;
+
+	struct Entry
+	{
+		//Ray arriving at the cached vertex
+		Ray ray;
+		HitRecord hit;
+		//Attenuation of the mirror chain in front of the vertex
+		Vector3 throughput;
+		//Light gathered when the chain ends before reaching a vertex
+		Vector3 radiance;
+		//Bounces taken by the chain
+		int depth;
+		//Length of the chain up to the vertex
+		float distance;
+		bool has_vertex;
+		unsigned int generation;
+		//Camera sample the ray was drawn with
+		unsigned int jitter;
+	};
+
+	void resize(int pixel_count);
+
+	//Drops every entry, must be called whenever the camera or the scene changes
+	void invalidate()
+	{
+		generation++;
+	}
+
+	Entry& get(int pixel, int sample)
+	{
+		return entries[pixel * JITTER_COUNT + sample % JITTER_COUNT];
+	}
+
+	//Camera sample index of the ray sample continues from. Consecutive entries of a pixel
+	//take consecutive indices, so the jitter positions stay stratified as they are replaced.
+	static unsigned int jitterSample(int sample)
+	{
+		return unsigned(sample / (JITTER_COUNT * REUSE_COUNT) * JITTER_COUNT + sample % JITTER_COUNT);
+	}
+
+	//Entries come back every JITTER_COUNT samples, and every JITTER_COUNT-th point of a
+	//low discrepancy sequence is badly stratified. Paths continuing from an entry instead
+	//take consecutive sample indices in a block of dimensions of their own.
+	static unsigned int pathSample(int sample)
+	{
+		return unsigned(sample / JITTER_COUNT);
+	}
+
+	static int pathFirstDimension(int sample)
+	{
+		return Sampler::CameraDimensions + (sample % JITTER_COUNT) * (MAX_RAY_DEPTH + 1) * Sampler::BounceDimensions;
+	}
+
+	//Whether entry holds the ray sample continues from
+	bool isFilled(const Entry& entry, int sample) const
+	{
+		return entry.generation == generation && entry.jitter == jitterSample(sample);
+	}
+
+	//Traces the deterministic prefix of camera_ray, drawn with camera sample jitter, and stores it in entry
+	void fill(Entry& entry, const Ray& camera_ray, unsigned int jitter, const Hitable* world) const;
+
+	//Follows camera_ray through perfect mirrors into entry, leaves the generation alone
+	static void traceMirrorChain(Entry& entry, const Ray& camera_ray, const Hitable* world);
+
+private:
+	std::vector<Entry> entries;
+	unsigned int generation = 1;
+};
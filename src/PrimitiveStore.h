@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+#include "AABB.h"
+
+class Material;
+class Hitable;
+
+//Closed set of primitive types the scene stores by value and dispatches with a switch.
+//Anything else is kept as Generic and still goes through the Hitable interface.
+enum class PrimitiveType : unsigned int
+{
+	Sphere,
+	MovingSphere,
+	XYRect,
+	XZRect,
+	YZRect,
+	Box,
+	Generic
+};
+
+struct SphereData
+{
+	Vector3 center;
+	float radius;
+	Material* mat_ptr;
+};
+
+struct MovingSphereData
+{
+	Vector3 center0, center1;
+	float time0, time1;
+	float radius;
+	Material* mat_ptr;
+};
+
+//Axis aligned rectangle on the plane where the normal axis equals k,
+//spanning [b0, b1] x [c0, c1] on the other two axes in x, y, z order
+struct RectData
+{
+	float b0, b1, c0, c1, k;
+	Material* mat_ptr;
+	bool flip_normals;
+};
+
+struct BoxData
+{
+	Vector3 center;
+	Vector3 dimensions;
+	Material* mat_ptr;
+};
+
+//Index of a primitive in the array for its type
+struct PrimitiveRef
+{
+	unsigned int type : 4;
+	unsigned int index : 28;
+};
+
+/**
+ * Data oriented copy of the scene geometry. Each primitive type lives in its
+ * own contiguous array, refs and bounds list every primitive in insertion order.
+ * Filled by Hitable::flatten when a scene is committed.
+ */
+class PrimitiveStore
+{
+public:
+	//Shutter interval the bounds are computed for
+	float time0 = 0.f, time1 = 0.f;
+
+	std::vector<SphereData> spheres;
+	std::vector<MovingSphereData> moving_spheres;
+	std::vector<RectData> rects;
+	std::vector<BoxData> boxes;
+	std::vector<const Hitable*> generic;
+
+	std::vector<PrimitiveRef> refs;
+	std::vector<AABB> bounds;
+
+	void add(const SphereData& sphere, const AABB& box)
+	{
+		addRef(PrimitiveType::Sphere, spheres.size(), box);
+		spheres.push_back(sphere);
+	}
+
+	void add(const MovingSphereData& sphere, const AABB& box)
+	{
+		addRef(PrimitiveType::MovingSphere, moving_spheres.size(), box);
+		moving_spheres.push_back(sphere);
+	}
+
+	//type is one of XYRect, XZRect or YZRect
+	void add(PrimitiveType type, const RectData& rect, const AABB& box)
+	{
+		addRef(type, rects.size(), box);
+		rects.push_back(rect);
+	}
+
+	void add(const BoxData& data, const AABB& box)
+	{
+		addRef(PrimitiveType::Box, boxes.size(), box);
+		boxes.push_back(data);
+	}
+
+	void add(const Hitable* hitable, const AABB& box)
+	{
+		addRef(PrimitiveType::Generic, generic.size(), box);
+		generic.push_back(hitable);
+	}
+
+private:
+	void addRef(PrimitiveType type, size_t index, const AABB& box)
+	{
+		PrimitiveRef ref;
+		ref.type = unsigned(type);
+		ref.index = unsigned(index);
+		refs.push_back(ref);
+		bounds.push_back(box);
+	}
+};
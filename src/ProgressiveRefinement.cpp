@@ -0,0 +1,91 @@
+#include "ProgressiveRefinement.h"
+#include "SampleScheduler.h"
+#include "Simd.h"
+#include <cmath>
+
+void ProgressiveRefinement::restart()
+{
+	if (budget_ms <= 0.0)
+		stride = MAX_STRIDE;
+	else
+	{
+		//The finest grid the budget is expected to fit, rounding to the nearest one would overshoot it
+		stride = int(ceilf(1.f / scale - 0.01f));
+		stride = stride < 1 ? 1 : stride > MAX_STRIDE ? MAX_STRIDE : stride;
+	}
+	restarted = true;
+}
+
+void ProgressiveRefinement::advance(double frame_ms)
+{
+	//Cost goes with the number of pixels, the square of the linear resolution
+	if (restarted && budget_ms > 0.0 && frame_ms > 0.0)
+	{
+		scale = float(1.0 / stride * sqrt(budget_ms / frame_ms));
+		scale = scale < 1.f / MAX_STRIDE ? 1.f / MAX_STRIDE : scale > 1.f ? 1.f : scale;
+	}
+	restarted = false;
+	stride = stride > 1 ? stride / 2 : 1;
+}
+
+void ProgressiveRefinement::fill(Vector3* pixels, const SampleScheduler& scheduler, int stride, int width, int height)
+{
+	//Padded to whole lanes, the padding repeats the last column
+	const int padded_width = (width + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+	if (table_stride != stride || int(left_offset.size()) != padded_width)
+	{
+		table_stride = stride;
+		left_offset.resize(padded_width);
+		right_offset.resize(padded_width);
+		right_weight.resize(padded_width);
+		const int last_column = (width - 1) / stride * stride;
+		for (int x = 0; x < padded_width; x++)
+		{
+			const int column = x < width ? x : width - 1;
+			const int left = column - column % stride;
+			const int right = left + stride <= last_column ? left + stride : left;
+			left_offset[x] = uint32_t(left * 3);
+			right_offset[x] = uint32_t(right * 3);
+			right_weight[x] = right > left ? float(column - left) / float(stride) : 0.f;
+		}
+	}
+	const int last_row = (height - 1) / stride * stride;
+
+	//Grid pixels always have samples and only pixels without any are written, so the image is upscaled in place
+#pragma omp parallel for
+	for (int row = 0; row < height; row++)
+	{
+		const int top = row - row % stride;
+		const int bottom = top + stride <= last_row ? top + stride : top;
+		const simd_f32 bottom_weight = simd_set(bottom > top ? float(row - top) / float(stride) : 0.f);
+		const float* top_row = pixels[top * width].data;
+		const float* bottom_row = pixels[bottom * width].data;
+
+		for (int x = 0; x < width; x += SIMD_LANES)
+		{
+			const simd_u32 left = simd_load(&left_offset[x]);
+			const simd_u32 right = simd_load(&right_offset[x]);
+			const simd_f32 right_w = simd_load(&right_weight[x]);
+
+			float upscaled[3][SIMD_LANES];
+			for (int c = 0; c < 3; c++)
+			{
+				const simd_f32 top_left = simd_gather(top_row + c, left);
+				const simd_f32 top_right = simd_gather(top_row + c, right);
+				const simd_f32 bottom_left = simd_gather(bottom_row + c, left);
+				const simd_f32 bottom_right = simd_gather(bottom_row + c, right);
+				const simd_f32 upper = simd_add(top_left, simd_mul(simd_sub(top_right, top_left), right_w));
+				const simd_f32 lower = simd_add(bottom_left, simd_mul(simd_sub(bottom_right, bottom_left), right_w));
+				simd_store(upscaled[c], simd_add(upper, simd_mul(simd_sub(lower, upper), bottom_weight)));
+			}
+
+			const int lanes = width - x < SIMD_LANES ? width - x : SIMD_LANES;
+			for (int i = 0; i < lanes; i++)
+			{
+				const int pixel = row * width + x + i;
+				if (scheduler.getSampleCount(pixel) == 0)
+					pixels[pixel] = Vector3(upscaled[0][i], upscaled[1][i], upscaled[2][i]);
+			}
+		}
+	}
+}
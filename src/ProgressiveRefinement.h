@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Vector3.h"
+
+class SampleScheduler;
+
+/**
+ * Lowers the resolution of frames rendered while the camera moves. Such frames only sample
+ * every stride-th pixel of every stride-th row and the rest are upscaled for display from
+ * that grid. Once the camera stops the stride halves every frame, so the window shows the
+ * new view after a fraction of a frame and sharpens over the next ones.
+ * Without a frame budget every move starts at MAX_STRIDE, one pixel in 16. With one, the
+ * stride of frames after a move is steered by how long the last ones took to hold the budget.
+ */
+class ProgressiveRefinement
+{
+public:
+	static const int MAX_STRIDE = 4;
+
+	//budget_ms is the time a frame may take while the camera moves, 0 for none
+	explicit ProgressiveRefinement(double budget_ms = 0.0) : budget_ms(budget_ms)
+	{
+	}
+
+	//Starts over from a coarse grid, called whenever the camera moves
+	void restart();
+
+	//Distance between sampled pixels in the current frame
+	int getStride() const
+	{
+		return stride;
+	}
+
+	//Moves on to a finer grid once the current frame is rendered, frame_ms is how long it took or 0 when unknown
+	void advance(double frame_ms);
+
+	//Upscales the pixels of the width by height image that have no samples in scheduler from those
+	//on the grid of stride, which the frame just rendered sampled
+	void fill(Vector3* pixels, const SampleScheduler& scheduler, int stride, int width, int height);
+
+private:
+	double budget_ms;
+	//Linear resolution the budget allows, learned from the frames rendered right after moves
+	float scale = 1.f / MAX_STRIDE;
+	int stride = 1;
+	//Whether the current frame is the first after a move
+	bool restarted = false;
+
+	//Per column offsets of the two grid columns around it, scaled to float index, and the weight of the right one
+	std::vector<uint32_t> left_offset, right_offset;
+	std::vector<float> right_weight;
+	int table_stride = 0;
+};
@@ -1,20 +1,145 @@
-#pragma once
 #include "Random.h"
 #include "Vector3.h"
+#include "Sampling.h"
+#include "Simd.h"
 
 #define constapm 16807
-#define constmpm 2147483647.0
+#define constmpm 2147483647
+
+uint32_t Random::base_seed = 0;
+
+thread_local uint32_t Random::stream_pixel = 0;
+thread_local uint32_t Random::stream_sample = 0;
+thread_local uint32_t Random::stream_dimension = 0;
+thread_local uint32_t Random::stream_counter = 0;
+thread_local uint32_t Random::buffer[Random::BUFFER_SIZE];
+thread_local int Random::buffer_position = Random::BUFFER_SIZE;
+
+//hash4 on every lane, the scalar version below is the reference
+static inline simd_u32 hash4_lanes(simd_u32 a, simd_u32 b, simd_u32 c, simd_u32 d)
+{
+	const simd_u32 multiplier = simd_set(1664525U);
+	const simd_u32 increment = simd_set(1013904223U);
+	a = simd_add(simd_mul(a, multiplier), increment);
+	b = simd_add(simd_mul(b, multiplier), increment);
+	c = simd_add(simd_mul(c, multiplier), increment);
+	d = simd_add(simd_mul(d, multiplier), increment);
+
+	a = simd_add(a, simd_mul(b, d));
+	b = simd_add(b, simd_mul(c, a));
+	c = simd_add(c, simd_mul(a, b));
+	d = simd_add(d, simd_mul(b, c));
+
+	a = simd_xor(a, simd_shift_right(a, 16));
+	b = simd_xor(b, simd_shift_right(b, 16));
+	c = simd_xor(c, simd_shift_right(c, 16));
+	d = simd_xor(d, simd_shift_right(d, 16));
+
+	a = simd_add(a, simd_mul(b, d));
+	b = simd_add(b, simd_mul(c, a));
+	c = simd_add(c, simd_mul(a, b));
+	d = simd_add(d, simd_mul(b, c));
+	return simd_xor(a, d);
+}
+
+static inline float to_uniform(uint32_t bits)
+{
+	return float(bits >> 8) * (1.f / 16777216.f);
+}
 
 void Random::seed(long unsigned int seed)
 {
-	g_seed = seed;
+	base_seed = uint32_t(seed);
+}
+
+void Random::setStream(uint32_t pixel, uint32_t sample, uint32_t dimension)
+{
+	stream_pixel = pixel;
+	stream_sample = sample;
+	stream_dimension = dimension;
+	stream_counter = 0;
+	buffer_position = BUFFER_SIZE;
+}
+
+uint32_t Random::hash4(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+	a = a * 1664525U + 1013904223U;
+	b = b * 1664525U + 1013904223U;
+	c = c * 1664525U + 1013904223U;
+	d = d * 1664525U + 1013904223U;
+
+	a += b * d;
+	b += c * a;
+	c += a * b;
+	d += b * c;
+
+	a ^= a >> 16;
+	b ^= b >> 16;
+	c ^= c >> 16;
+	d ^= d >> 16;
+
+	a += b * d;
+	b += c * a;
+	c += a * b;
+	d += b * c;
+	return a ^ d;
+}
+
+uint32_t Random::streamKey()
+{
+	return stream_dimension + base_seed * 0x9e3779b9U;
+}
+
+//Hashes the next BUFFER_SIZE draws of the stream
+void Random::refill()
+{
+	const simd_u32 pixel = simd_set(stream_pixel);
+	const simd_u32 sample = simd_set(stream_sample);
+	const simd_u32 key = simd_set(streamKey());
+	for (int i = 0; i < BUFFER_SIZE; i += SIMD_LANES)
+		simd_store(buffer + i, hash4_lanes(pixel, sample, key, simd_ramp(stream_counter + uint32_t(i))));
+	stream_counter += BUFFER_SIZE;
+	buffer_position = 0;
+}
+
+uint32_t Random::next()
+{
+	if (buffer_position == BUFFER_SIZE)
+		refill();
+	return buffer[buffer_position++];
+}
+
+float Random::uniform()
+{
+	return to_uniform(next());
+}
+
+void Random::fill(float* out, int count)
+{
+	//Whatever is left of the buffer comes first so the stream stays in order
+	int i = 0;
+	for (; i < count && buffer_position < BUFFER_SIZE; i++)
+		out[i] = to_uniform(buffer[buffer_position++]);
+
+	const simd_u32 pixel = simd_set(stream_pixel);
+	const simd_u32 sample = simd_set(stream_sample);
+	const simd_u32 key = simd_set(streamKey());
+	uint32_t bits[SIMD_LANES];
+	for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+	{
+		simd_store(bits, hash4_lanes(pixel, sample, key, simd_ramp(stream_counter)));
+		stream_counter += SIMD_LANES;
+		for (int lane = 0; lane < SIMD_LANES; lane++)
+			out[i + lane] = to_uniform(bits[lane]);
+	}
+
+	for (; i < count; i++)
+		out[i] = uniform();
 }
 
 
 unsigned long Random::rand31pm_next(unsigned long* seedp)
 {
-	double const a = constapm;
-	double const m = constmpm;
 	/* This is the linear congrentual 
 	 * generator:
 	 *  
@@ -24,17 +149,18 @@ unsigned long Random::rand31pm_next(unsigned long* seedp)
 	 * constant m.
 	 */
 
-	return (*seedp = long(fmod((*seedp * a), m)));
+	return (*seedp = (unsigned long)(uint64_t(*seedp) * constapm % constmpm));
 }
 
 unsigned long Random::rand31pm_next()
 {
-	return rand31pm_next(&g_seed);
+	//Same range as the Lehmer generator, [1, m - 1]
+	return 1 + next() % (constmpm - 1);
 }
 
 int Random::randi(int max)
 {
-	return randi(&g_seed, max);
+	return int((uint64_t(next()) * uint64_t(max)) >> 32);
 }
 
 int Random::randi(unsigned long* seedp, int max)
@@ -45,7 +171,7 @@ int Random::randi(unsigned long* seedp, int max)
 
 unsigned int Random::randu(unsigned max)
 {
-	return randu(&g_seed, max);
+	return unsigned((uint64_t(next()) * uint64_t(max)) >> 32);
 }
 
 unsigned Random::randu(unsigned long* seedp, unsigned max)
@@ -56,7 +182,7 @@ unsigned Random::randu(unsigned long* seedp, unsigned max)
 
 double Random::randd(const double min, const double max)
 {
-	return randd(&g_seed, min, max);
+	return min + double(next()) * (1.0 / 4294967296.0) * (max - min);
 }
 
 double Random::randd(unsigned long* seedp, double min, double max)
@@ -67,7 +193,7 @@ double Random::randd(unsigned long* seedp, double min, double max)
 
 float Random::randf(const float min, const float max)
 {
-	return randf(&g_seed, min, max);
+	return min + uniform() * (max - min);
 }
 
 float Random::randf(unsigned long* seedp, float min, float max)
@@ -77,35 +203,54 @@ float Random::randf(unsigned long* seedp, float min, float max)
 
 Vector3 Random::random_in_unit_sphere()
 {
-	return random_in_unit_sphere(&g_seed);
+	const float u1 = uniform();
+	const float u2 = uniform();
+	return sample_uniform_ball(u1, u2, uniform());
 }
 
 Vector3 Random::random_in_unit_sphere(unsigned long* seedp)
 {
-	Vector3 p;
-	do
-	{
-		p.set(randf(seedp, -1, 1), randf(seedp, -1, 1), randf(seedp, -1, 1));
-	}
-	while (p.getSquaredLength() >= 1.0);
-	return p;
+	const float u1 = randf(seedp, 0, 1);
+	const float u2 = randf(seedp, 0, 1);
+	const float u3 = randf(seedp, 0, 1);
+	return sample_uniform_ball(u1, u2, u3);
 }
 
 Vector3 Random::random_in_unit_disk()
 {
-	return random_in_unit_disk(&g_seed);
+	const float u1 = uniform();
+	return sample_concentric_disk(u1, uniform());
 }
 
 Vector3 Random::random_in_unit_disk(unsigned long* seedp)
 {
-	Vector3 p;
-	do
-	{
-		p.set(randf(seedp, -1, 1), randf(seedp, -1, 1), 0);
-	}
-	while (p.getSquaredLength() >= 1.0);
-	return p;
+	const float u1 = randf(seedp, 0, 1);
+	const float u2 = randf(seedp, 0, 1);
+	return sample_concentric_disk(u1, u2);
 }
 
+Vector3 Random::random_unit_vector()
+{
+	const float u1 = uniform();
+	return sample_uniform_sphere(u1, uniform());
+}
 
-long unsigned int Random::g_seed = 1;
+Vector3 Random::random_unit_vector(unsigned long* seedp)
+{
+	const float u1 = randf(seedp, 0, 1);
+	const float u2 = randf(seedp, 0, 1);
+	return sample_uniform_sphere(u1, u2);
+}
+
+Vector3 Random::random_cosine_direction(const Vector3& normal)
+{
+	const float u1 = uniform();
+	return sample_cosine_direction(normal, u1, uniform());
+}
+
+Vector3 Random::random_cosine_direction(unsigned long* seedp, const Vector3& normal)
+{
+	const float u1 = randf(seedp, 0, 1);
+	const float u2 = randf(seedp, 0, 1);
+	return sample_cosine_direction(normal, u1, u2);
+}
@@ -1,15 +1,32 @@
 #pragma once
-#include <random>
+#include <cstdint>
 
 class Vector3;
 
-
+/**
+ * Draws that take a seedp advance that caller owned Lehmer generator.
+ * Draws without one come from a counter based stream of the calling thread: each value
+ * is a stateless hash of the stream key and the index of the draw, so what a path sees
+ * depends only on the key it set and never on which thread runs it or what ran before.
+ * Streams are hashed SIMD_LANES draws at a time into a small buffer per thread, scalar draws
+ * pop from it and bulk draws fill caller arrays straight from the vectorised hash.
+ */
 struct Random
 {
-	static long unsigned int g_seed;
-
+	//Mixed into every stream key, changing it gives a different but still reproducible image
 	static void seed(long unsigned int seed);
 
+	//Starts the stream of the calling thread for a pixel, sample and dimension block
+	static void setStream(uint32_t pixel, uint32_t sample, uint32_t dimension);
+	//Next 32 random bits of the stream of the calling thread
+	static uint32_t next();
+
+	//Next count uniform floats in [0, 1) of the stream of the calling thread, the values count randf(0, 1) would give
+	static void fill(float* out, int count);
+
+	//PCG style hash of four words, the 4D variant from Jarzynski and Olano 2020
+	static uint32_t hash4(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+
 	static long unsigned int rand31pm_next(long unsigned int* seedp);
 	static long unsigned int rand31pm_next();
 
@@ -26,9 +43,36 @@ struct Random
 	static float randf(float min, float max);
 	static float randf(long unsigned int* seedp, float min, float max);
 
+	//Closed form samplers, each draws a fixed count of numbers, see Sampling.h
 	static Vector3 random_in_unit_sphere();
 	static Vector3 random_in_unit_sphere(long unsigned int* seedp);
 
 	static Vector3 random_in_unit_disk();
 	static Vector3 random_in_unit_disk(long unsigned int* seedp);
+
+	static Vector3 random_unit_vector();
+	static Vector3 random_unit_vector(long unsigned int* seedp);
+
+	//Direction around the unit normal with density cos(theta) / PI
+	static Vector3 random_cosine_direction(const Vector3& normal);
+	static Vector3 random_cosine_direction(long unsigned int* seedp, const Vector3& normal);
+
+private:
+	static uint32_t base_seed;
+
+	static thread_local uint32_t stream_pixel;
+	static thread_local uint32_t stream_sample;
+	static thread_local uint32_t stream_dimension;
+	static thread_local uint32_t stream_counter;
+
+	//Draws hashed ahead for the stream of the calling thread, a multiple of SIMD_LANES
+	static const int BUFFER_SIZE = 16;
+	static thread_local uint32_t buffer[BUFFER_SIZE];
+	static thread_local int buffer_position;
+
+	static uint32_t streamKey();
+	static void refill();
+
+	//Uniform float in [0, 1) from the stream of the calling thread
+	static float uniform();
 };
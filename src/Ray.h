@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include "Vector3.h"
 
 class Ray
@@ -60,3 +61,30 @@ public:
 		return origin + ((z - origin.z) / direction.z) * direction;
 	}
 };
+
+
+/**
+ * Per ray data used by box tests, computed once per ray instead of once per node.
+ * Direction components too small to invert are clamped away from zero so the
+ * slab distances of axis parallel rays stay finite instead of becoming NaN.
+ */
+class PreparedRay
+{
+public:
+	Vector3 origin;
+	Vector3 inv_direction;
+	//1 where the direction is negative, selects which bound is the near one on each axis
+	int sign[3];
+
+	explicit PreparedRay(const Ray& ray) : origin(ray.origin)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			float d = ray.direction[a];
+			if (fabsf(d) < 1e-20f)
+				d = d < 0.f ? -1e-20f : 1e-20f;
+			inv_direction[a] = 1.0f / d;
+			sign[a] = inv_direction[a] < 0.f;
+		}
+	}
+};
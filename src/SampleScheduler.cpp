@@ -0,0 +1,165 @@
+#include "SampleScheduler.h"
+#include "AccumulationBuffer.h"
+#include "Random.h"
+#include <cmath>
+#include <algorithm>
+
+void SampleScheduler::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	count.resize(width * height);
+	m2.resize(width * height);
+	tile_samples.resize(tiles_x * tiles_y);
+	tile_error.resize(tiles_x * tiles_y);
+	reset();
+}
+
+void SampleScheduler::reset()
+{
+	std::fill(count.begin(), count.end(), 0);
+	std::fill(m2.begin(), m2.end(), 0.f);
+	frame = 0;
+}
+
+void SampleScheduler::reproject(const std::vector<int>& source, const std::vector<int>& max_count)
+{
+	previous_count.swap(count);
+	previous_m2.swap(m2);
+	count.resize(previous_count.size());
+	m2.resize(previous_m2.size());
+	for (int pixel = 0; pixel < int(count.size()); pixel++)
+	{
+		const int from = source[pixel];
+		if (from < 0)
+		{
+			count[pixel] = 0;
+			m2[pixel] = 0.f;
+			continue;
+		}
+		//m2 grows with the sample count, scaling it keeps the variance estimate
+		const int n = previous_count[from];
+		count[pixel] = n < max_count[pixel] ? n : max_count[pixel];
+		m2[pixel] = n > 0 ? previous_m2[from] * float(count[pixel]) / float(n) : 0.f;
+	}
+	frame = 0;
+}
+
+int SampleScheduler::schedule(const AccumulationBuffer& accumulation, int budget, int stride)
+{
+	this->stride = stride;
+	int scheduled = 0;
+	float total_error = 0.f;
+	std::vector<int> adaptive_tiles;
+
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			const int tile = ty * tiles_x + tx;
+			const int x_end = (tx + 1) * TILE_SIZE < width ? (tx + 1) * TILE_SIZE : width;
+			const int y_end = (ty + 1) * TILE_SIZE < height ? (ty + 1) * TILE_SIZE : height;
+			const int pixels = gridPixels(tx * TILE_SIZE, x_end) * gridPixels(ty * TILE_SIZE, y_end);
+			if (pixels == 0)
+			{
+				tile_samples[tile] = 0;
+				continue;
+			}
+
+			//Worst pixel of the tile decides, a single firefly keeps the tile alive
+			int min_count = count[ty * TILE_SIZE * width + tx * TILE_SIZE];
+			float error = 0.f;
+			for (int y = ty * TILE_SIZE; y < y_end; y++)
+			{
+				for (int x = tx * TILE_SIZE; x < x_end; x++)
+				{
+					const int pixel = y * width + x;
+					const int n = count[pixel];
+					min_count = n < min_count ? n : min_count;
+					if (n < 2)
+						continue;
+					const float variance_of_mean = m2[pixel] / float(n - 1) / float(n);
+					const float pixel_error = sqrtf(variance_of_mean) / (luminance(accumulation.getMean(pixel, n)) + 0.01f);
+					error = pixel_error > error ? pixel_error : error;
+				}
+			}
+
+			if (has_focus)
+			{
+				//Pixels without any sample would show as holes, they get their first one wherever they are.
+				//Every other tile not converged yet competes for the budget by how close it is to the focus.
+				tile_samples[tile] = min_count == 0 ? 1 : 0;
+				tile_error[tile] = 0.f;
+				scheduled += tile_samples[tile] * pixels;
+				if (min_count == 0 || (min_count >= MIN_SAMPLES && error < ERROR_THRESHOLD))
+					continue;
+				tile_error[tile] = focusWeight(tx, ty) * float(pixels);
+				total_error += tile_error[tile];
+				adaptive_tiles.push_back(tile);
+			}
+			else if (min_count < MIN_SAMPLES)
+			{
+				tile_samples[tile] = 1;
+				tile_error[tile] = 0.f;
+				scheduled += pixels;
+			}
+			else if (error < ERROR_THRESHOLD)
+			{
+				tile_samples[tile] = 0;
+				tile_error[tile] = 0.f;
+			}
+			else
+			{
+				tile_samples[tile] = 0;
+				tile_error[tile] = error * float(pixels);
+				total_error += tile_error[tile];
+				adaptive_tiles.push_back(tile);
+			}
+		}
+	}
+
+	//Split what is left in proportion to the error, the fraction is rounded stochastically
+	const int remaining = budget - scheduled;
+	for (const int tile : adaptive_tiles)
+	{
+		if (remaining <= 0 || total_error <= 0.f)
+			break;
+
+		const int tx = tile % tiles_x, ty = tile / tiles_x;
+		const int x_end = (tx + 1) * TILE_SIZE < width ? (tx + 1) * TILE_SIZE : width;
+		const int y_end = (ty + 1) * TILE_SIZE < height ? (ty + 1) * TILE_SIZE : height;
+		const int pixels = gridPixels(tx * TILE_SIZE, x_end) * gridPixels(ty * TILE_SIZE, y_end);
+
+		const float share = float(remaining) * tile_error[tile] / total_error / float(pixels);
+		const float dither = float(Random::hash4(uint32_t(tile), frame, 0, 0) >> 8) * (1.f / 16777216.f);
+		int samples = int(share + dither);
+		samples = samples < MAX_SAMPLES_PER_FRAME ? samples : MAX_SAMPLES_PER_FRAME;
+		tile_samples[tile] = samples;
+		scheduled += samples * pixels;
+	}
+
+	frame++;
+	return scheduled;
+}
+
+float SampleScheduler::focusWeight(int tx, int ty) const
+{
+	//Distance from the tile centre to the focus rectangle, zero inside it
+	const float x = (float(tx) + 0.5f) * float(TILE_SIZE), y = (float(ty) + 0.5f) * float(TILE_SIZE);
+	const float dx = x < focus_x0 ? focus_x0 - x : x > focus_x1 ? x - focus_x1 : 0.f;
+	const float dy = y < focus_y0 ? focus_y0 - y : y > focus_y1 ? y - focus_y1 : 0.f;
+	const float distance_squared = (dx * dx + dy * dy) / (focus_falloff * focus_falloff);
+	//Gaussian that halves at falloff
+	return PERIPHERY_WEIGHT + (1.f - PERIPHERY_WEIGHT) * expf(-0.6931472f * distance_squared);
+}
+
+void SampleScheduler::accumulate(AccumulationBuffer& accumulation, int pixel, const Vector3& color)
+{
+	const float old_mean = luminance(accumulation.getMean(pixel, count[pixel]));
+	accumulation.add(pixel, color);
+	const int n = ++count[pixel];
+	const float sample = luminance(color);
+	m2[pixel] += (sample - old_mean) * (sample - (old_mean + (sample - old_mean) / float(n)));
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+
+class AccumulationBuffer;
+
+/**
+ * Spends a per frame sample budget where the image is still noisy.
+ * Each pixel keeps its sample count and the running variance of its luminance
+ * next to the sum in the AccumulationBuffer. Tiles are sampled uniformly until every pixel
+ * has MIN_SAMPLES, after that the budget is split between tiles in proportion to
+ * their estimated error and tiles below ERROR_THRESHOLD get no samples at all.
+ * With a focus set the budget is split by closeness to the focus instead, so the region
+ * being looked at converges first while the periphery keeps refining slowly.
+ */
+class SampleScheduler
+{
+public:
+	//Side of the square tiles the budget is assigned to
+	static const int TILE_SIZE = 8;
+	//Samples every pixel gets before its variance estimate is trusted
+	static const int MIN_SAMPLES = 16;
+	//Most samples a pixel can get in one frame
+	static const int MAX_SAMPLES_PER_FRAME = 8;
+	//Relative standard error of the mean below which a tile counts as converged
+	static constexpr float ERROR_THRESHOLD = 0.02f;
+	//Share of the budget a tile far from the focus gets relative to one inside it
+	static constexpr float PERIPHERY_WEIGHT = 0.05f;
+
+	void resize(int width, int height);
+
+	//Forgets every estimate, must be called whenever the AccumulationBuffer is cleared
+	void reset();
+
+	//Carries the estimates over to a new view, pixel i takes those of pixel source[i] or starts over when it is -1.
+	//Sample counts are capped at max_count[i] so that stale history gives way to new samples quickly.
+	void reproject(const std::vector<int>& source, const std::vector<int>& max_count);
+
+	//Decides how many samples each pixel gets this frame from the mean and the variance so far,
+	//spending about budget samples or fewer once tiles converge. Returns the number scheduled.
+	//With a stride above 1 only every stride-th pixel of every stride-th row is sampled.
+	int schedule(const AccumulationBuffer& accumulation, int budget, int stride = 1);
+
+	//Spends the budget of the next frames around the pixels from x0, row0 to x1, row1, exclusive, tiles
+	//falloff pixels away from it get about half the samples of those inside
+	void setFocus(int x0, int row0, int x1, int row1, float falloff)
+	{
+		focus_x0 = float(x0);
+		focus_y0 = float(row0);
+		focus_x1 = float(x1);
+		focus_y1 = float(row1);
+		focus_falloff = falloff;
+		has_focus = true;
+	}
+
+	//Goes back to spending the budget wherever the image is noisiest
+	void clearFocus()
+	{
+		has_focus = false;
+	}
+
+	//Samples scheduled for pixel in the current frame
+	int getScheduled(int pixel) const
+	{
+		if (stride > 1 && ((pixel % width) % stride != 0 || (pixel / width) % stride != 0))
+			return 0;
+		return tile_samples[tileOf(pixel)];
+	}
+
+	//Samples accumulated into pixel so far
+	int getSampleCount(int pixel) const
+	{
+		return count[pixel];
+	}
+
+	//Samples pixel of the previous view had before the last reproject
+	int getPreviousSampleCount(int pixel) const
+	{
+		return previous_count[pixel];
+	}
+
+	//Variance of the mean luminance of pixel, negative while it has fewer than two samples
+	float getVariance(int pixel) const
+	{
+		const int n = count[pixel];
+		return n < 2 ? -1.f : m2[pixel] / float(n - 1) / float(n);
+	}
+
+	//Adds a sample to the sum in accumulation and to the count and variance of pixel
+	void accumulate(AccumulationBuffer& accumulation, int pixel, const Vector3& color);
+
+private:
+	int width = 0, height = 0;
+	int tiles_x = 0, tiles_y = 0;
+	unsigned int frame = 0;
+	int stride = 1;
+
+	std::vector<int> count;
+	//Sum of squared luminance deviations from the mean, Welford's update
+	std::vector<float> m2;
+	//Estimates of the previous view while reprojecting
+	std::vector<int> previous_count;
+	std::vector<float> previous_m2;
+	std::vector<int> tile_samples;
+	//Error of each tile times its pixels, or with a focus its closeness to it, the budget is split by it
+	std::vector<float> tile_error;
+
+	bool has_focus = false;
+	float focus_x0 = 0.f, focus_y0 = 0.f, focus_x1 = 0.f, focus_y1 = 0.f;
+	float focus_falloff = 1.f;
+
+	//Columns or rows from begin to end, exclusive, on the grid sampled with the current stride
+	int gridPixels(int begin, int end) const
+	{
+		return (end + stride - 1) / stride - (begin + stride - 1) / stride;
+	}
+
+	//Share of the budget for tile tx, ty relative to one inside the focus
+	float focusWeight(int tx, int ty) const;
+
+	int tileOf(int pixel) const
+	{
+		return (pixel / width / TILE_SIZE) * tiles_x + (pixel % width) / TILE_SIZE;
+	}
+
+	static float luminance(const Vector3& color)
+	{
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	}
+};
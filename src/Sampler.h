@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Source of sample values in [0, 1) keyed by pixel, sample index and dimension.
+ * The same key always gives the same value, so every dimension of a path can be
+ * drawn from a well distributed sequence instead of a running generator.
+ * Dimensions follow a fixed layout, camera dimensions first and then a block per bounce.
+ */
+class Sampler
+{
+public:
+	//Dimensions drawn for a camera ray
+	enum CameraDimension
+	{
+		PixelX,
+		PixelY,
+		LensU,
+		LensV,
+		Time,
+		CameraDimensions
+	};
+
+	//Dimensions drawn at each bounce, offset by the depth of the path
+	enum BounceDimension
+	{
+		LightSelect,
+		LightU,
+		LightV,
+		BsdfU,
+		BsdfV,
+		BsdfW,
+		BsdfChoice,
+		Roulette,
+		BounceDimensions
+	};
+
+	virtual ~Sampler() = default;
+
+	virtual float get(int pixel, unsigned int sample, int dimension) const = 0;
+
+	//Avalanching integer hash, used to derive independent seeds from keys
+	static uint32_t hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352dU;
+		x ^= x >> 15;
+		x *= 0x846ca68bU;
+		x ^= x >> 16;
+		return x;
+	}
+
+	static uint32_t hash(uint32_t a, uint32_t b)
+	{
+		return hash(a ^ (hash(b) + 0x9e3779b9U + (a << 6) + (a >> 2)));
+	}
+
+	static uint32_t reverseBits(uint32_t x)
+	{
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffU) << 8) | ((x & 0xff00ff00U) >> 8);
+		x = ((x & 0x0f0f0f0fU) << 4) | ((x & 0xf0f0f0f0U) >> 4);
+		x = ((x & 0x33333333U) << 2) | ((x & 0xccccccccU) >> 2);
+		x = ((x & 0x55555555U) << 1) | ((x & 0xaaaaaaaaU) >> 1);
+		return x;
+	}
+
+	//Maps 32 random bits to a float strictly below 1
+	static float toFloat(uint32_t x)
+	{
+		return float(x >> 8) * (1.f / 16777216.f);
+	}
+};
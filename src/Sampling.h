@@ -0,0 +1,73 @@
+#pragma once
+#include <cmath>
+#include "Vector3.h"
+#include "Globals.h"
+
+/**
+ * Closed form warps from uniform numbers in [0, 1) to points and directions.
+ * Each one consumes a fixed count of numbers, so the cost of a sample never
+ * varies and the numbers can come from any generator or sampler.
+ */
+
+//Point in the unit disk on the xy plane, concentric mapping of the square so strata stay compact
+inline Vector3 sample_concentric_disk(float u1, float u2)
+{
+	const float a = 2.f * u1 - 1.f;
+	const float b = 2.f * u2 - 1.f;
+	if (a == 0.f && b == 0.f)
+		return Vector3(0, 0, 0);
+
+	float r, theta;
+	if (a * a > b * b)
+	{
+		r = a;
+		theta = PI / 4.f * (b / a);
+	}
+	else
+	{
+		r = b;
+		theta = PI / 2.f - PI / 4.f * (a / b);
+	}
+	return Vector3(r * cosf(theta), r * sinf(theta), 0);
+}
+
+//Direction uniformly distributed over the unit sphere
+inline Vector3 sample_uniform_sphere(float u1, float u2)
+{
+	const float z = 1.f - 2.f * u1;
+	const float r = sqrtf(fmaxf(0.f, 1.f - z * z));
+	const float phi = 2.f * PI * u2;
+	return Vector3(r * cosf(phi), r * sinf(phi), z);
+}
+
+//Point uniformly distributed inside the unit sphere
+inline Vector3 sample_uniform_ball(float u1, float u2, float u3)
+{
+	return sample_uniform_sphere(u1, u2) * cbrtf(u3);
+}
+
+//Direction over the hemisphere around +z with density cos(theta) / PI
+inline Vector3 sample_cosine_hemisphere(float u1, float u2)
+{
+	const Vector3 d = sample_concentric_disk(u1, u2);
+	return Vector3(d.x, d.y, sqrtf(fmaxf(0.f, 1.f - d.x * d.x - d.y * d.y)));
+}
+
+//Tangent and bitangent completing an orthonormal basis with the unit vector n, without branches on n
+inline void make_basis(const Vector3& n, Vector3& tangent, Vector3& bitangent)
+{
+	const float sign = copysignf(1.f, n.z);
+	const float a = -1.f / (sign + n.z);
+	const float b = n.x * n.y * a;
+	tangent = Vector3(1.f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+	bitangent = Vector3(b, sign + n.y * n.y * a, -n.y);
+}
+
+//Direction over the hemisphere around the unit normal with density cos(theta) / PI
+inline Vector3 sample_cosine_direction(const Vector3& normal, float u1, float u2)
+{
+	const Vector3 local = sample_cosine_hemisphere(u1, u2);
+	Vector3 tangent, bitangent;
+	make_basis(normal, tangent, bitangent);
+	return tangent * local.x + bitangent * local.y + normal * local.z;
+}
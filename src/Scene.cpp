@@ -0,0 +1,430 @@
+#include "Scene.h"
+#include "Sphere.h"
+#include "MovingSphere.h"
+#include "XYRect.h"
+#include "Box.h"
+#include "Material.h"
+#include "Sampling.h"
+#include "Globals.h"
+#include <algorithm>
+
+void Scene::commit(const Hitable* root, float t0, float t1)
+{
+	primitives = PrimitiveStore();
+	primitives.time0 = t0;
+	primitives.time1 = t1;
+	order.clear();
+	nodes.clear();
+
+	root->flatten(primitives);
+	collectLights();
+
+	const int count = int(primitives.refs.size());
+	if (count == 0)
+		return;
+
+	std::vector<Vector3> centroids(count);
+	std::vector<int> indices(count);
+	for (int i = 0; i < count; i++)
+	{
+		centroids[i] = (primitives.bounds[i].min + primitives.bounds[i].max) * 0.5f;
+		indices[i] = i;
+	}
+
+	order.reserve(count);
+	nodes.reserve(2 * count);
+	build(indices, 0, count, centroids);
+}
+
+static float surface_area(const AABB& box)
+{
+	const Vector3 d = box.max - box.min;
+	return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+//Builds the subtree over indices [begin, end) by splitting at the median centroid
+//along the axis of largest centroid extent. Returns the index of the subtree root.
+int Scene::build(std::vector<int>& indices, int begin, int end, const std::vector<Vector3>& centroids)
+{
+	const int node_index = int(nodes.size());
+	nodes.push_back(Node());
+
+	AABB box = primitives.bounds[indices[begin]];
+	AABB centroid_box(centroids[indices[begin]], centroids[indices[begin]]);
+	for (int i = begin + 1; i < end; i++)
+	{
+		box = surrounding_box(box, primitives.bounds[indices[i]]);
+		centroid_box = surrounding_box(centroid_box, AABB(centroids[indices[i]], centroids[indices[i]]));
+	}
+
+	const int count = end - begin;
+	const int axis = (centroid_box.max - centroid_box.min).getLargestComponentIndex();
+	const int mid = begin + count / 2;
+	bool make_leaf = count == 1;
+
+	if (!make_leaf)
+	{
+		std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+		                 [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+		//Surface area heuristic with unit traversal and intersection cost.
+		//Large overlapping primitives such as the walls of a room make splitting pointless.
+		if (count <= MAX_LEAF_SIZE)
+		{
+			AABB left = primitives.bounds[indices[begin]];
+			AABB right = primitives.bounds[indices[mid]];
+			for (int i = begin + 1; i < mid; i++)
+				left = surrounding_box(left, primitives.bounds[indices[i]]);
+			for (int i = mid + 1; i < end; i++)
+				right = surrounding_box(right, primitives.bounds[indices[i]]);
+
+			const float area = surface_area(box);
+			const float split_cost = 1.f + (surface_area(left) * float(mid - begin) +
+				surface_area(right) * float(end - mid)) / area;
+			make_leaf = area <= 0.f || split_cost >= float(count);
+		}
+	}
+
+	if (make_leaf)
+	{
+		Node& leaf = nodes[node_index];
+		leaf.box = box;
+		leaf.offset = int(order.size());
+		leaf.count = (unsigned short)count;
+		leaf.axis = 0;
+		for (int i = begin; i < end; i++)
+			order.push_back(indices[i]);
+		return node_index;
+	}
+
+	build(indices, begin, mid, centroids);
+	const int second = build(indices, mid, end, centroids);
+
+	Node& node = nodes[node_index];
+	node.box = box;
+	node.offset = second;
+	node.count = 0;
+	node.axis = (unsigned short)axis;
+	return node_index;
+}
+
+bool Scene::bounding_box(float t0, float t1, AABB& b) const
+{
+	if (nodes.empty())
+		return false;
+	b = nodes[0].box;
+	return true;
+}
+
+bool Scene::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const
+{
+	return traverse<false>(ray, t_min, t_max, hit_record);
+}
+
+bool Scene::occluded(const Ray& ray, float t_min, float t_max) const
+{
+	HitRecord rec;
+	return traverse<true>(ray, t_min, t_max, rec);
+}
+
+//Closest hit traversal, or with ANY_HIT stops at the first primitive hit in range
+template <bool ANY_HIT>
+bool Scene::traverse(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const
+{
+	if (nodes.empty())
+		return false;
+
+	const PreparedRay prepared(ray);
+
+	int stack[64];
+	int stack_size = 0;
+	int current = 0;
+	bool hit_anything = false;
+
+	while (true)
+	{
+		const Node& node = nodes[current];
+		if (node.box.hit(prepared, t_min, t_max))
+		{
+			if (node.count > 0)
+			{
+				for (int i = 0; i < node.count; i++)
+				{
+					const int primitive = order[node.offset + i];
+					if (hitPrimitive(primitive, ray, t_min, t_max, hit_record))
+					{
+						if (ANY_HIT)
+							return true;
+						hit_anything = true;
+						t_max = hit_record.t;
+						hit_record.primitive = primitive;
+					}
+				}
+			}
+			else
+			{
+				//Visit the near child first so the far one can be culled by a closer hit
+				if (prepared.sign[node.axis])
+				{
+					stack[stack_size++] = current + 1;
+					current = node.offset;
+				}
+				else
+				{
+					stack[stack_size++] = node.offset;
+					current = current + 1;
+				}
+				continue;
+			}
+		}
+
+		if (stack_size == 0)
+			break;
+		current = stack[--stack_size];
+	}
+	return hit_anything;
+}
+
+inline bool Scene::hitPrimitive(int primitive, const Ray& ray, float t_min, float t_max,
+                                HitRecord& hit_record) const
+{
+	const PrimitiveRef ref = primitives.refs[primitive];
+	switch (PrimitiveType(ref.type))
+	{
+	case PrimitiveType::Sphere:
+		return Sphere::intersect(primitives.spheres[ref.index], ray, t_min, t_max, hit_record);
+	case PrimitiveType::MovingSphere:
+		return MovingSphere::intersect(primitives.moving_spheres[ref.index], ray, t_min, t_max, hit_record);
+	case PrimitiveType::XYRect:
+		return intersectRect<2, 0, 1>(primitives.rects[ref.index], ray, t_min, t_max, hit_record);
+	case PrimitiveType::XZRect:
+		return intersectRect<1, 0, 2>(primitives.rects[ref.index], ray, t_min, t_max, hit_record);
+	case PrimitiveType::YZRect:
+		return intersectRect<0, 1, 2>(primitives.rects[ref.index], ray, t_min, t_max, hit_record);
+	case PrimitiveType::Box:
+		return Box::intersect(primitives.boxes[ref.index], ray, t_min, t_max, hit_record);
+	default:
+		{
+			//Generic objects may write the record even when they miss
+			HitRecord rec;
+			if (!primitives.generic[ref.index]->hit(ray, t_min, t_max, rec))
+				return false;
+			hit_record = rec;
+			return true;
+		}
+	}
+}
+
+Material* Scene::getMaterial(int primitive) const
+{
+	const PrimitiveRef ref = primitives.refs[primitive];
+	switch (PrimitiveType(ref.type))
+	{
+	case PrimitiveType::Sphere:
+		return primitives.spheres[ref.index].mat_ptr;
+	case PrimitiveType::MovingSphere:
+		return primitives.moving_spheres[ref.index].mat_ptr;
+	case PrimitiveType::XYRect:
+	case PrimitiveType::XZRect:
+	case PrimitiveType::YZRect:
+		return primitives.rects[ref.index].mat_ptr;
+	case PrimitiveType::Box:
+		return primitives.boxes[ref.index].mat_ptr;
+	default:
+		return nullptr;
+	}
+}
+
+//Registers every sphere and rectangle with an emissive material and builds the light tree over them.
+//Boxes and generic objects are not sampled, paths that hit them still pick up their emission.
+void Scene::collectLights()
+{
+	lights.clear();
+	light_of_primitive.assign(primitives.refs.size(), -1);
+	std::vector<AABB> light_bounds;
+	std::vector<float> light_power;
+
+	for (int i = 0; i < int(primitives.refs.size()); i++)
+	{
+		const Material* material = getMaterial(i);
+		if (material == nullptr || !material->isEmissive())
+			continue;
+
+		const PrimitiveRef ref = primitives.refs[i];
+		float area;
+		switch (PrimitiveType(ref.type))
+		{
+		case PrimitiveType::Sphere:
+			{
+				const float radius = primitives.spheres[ref.index].radius;
+				area = 4.f * PI * radius * radius;
+				break;
+			}
+		case PrimitiveType::MovingSphere:
+			{
+				const float radius = primitives.moving_spheres[ref.index].radius;
+				area = 4.f * PI * radius * radius;
+				break;
+			}
+		case PrimitiveType::XYRect:
+		case PrimitiveType::XZRect:
+		case PrimitiveType::YZRect:
+			{
+				const RectData& rect = primitives.rects[ref.index];
+				area = (rect.b1 - rect.b0) * (rect.c1 - rect.c0);
+				break;
+			}
+		default:
+			continue;
+		}
+
+		//Power is estimated from the emission at the middle of the texture
+		HitRecord rec;
+		rec.position = (primitives.bounds[i].min + primitives.bounds[i].max) * 0.5f;
+		rec.u = rec.v = 0.5f;
+		const Vector3 emitted = material->emitted(Ray(), rec);
+		const float power = (emitted.r + emitted.g + emitted.b) / 3.f * area;
+		if (power <= 0.f)
+			continue;
+
+		light_of_primitive[i] = int(lights.size());
+		lights.push_back(AreaLight{i, area});
+		light_bounds.push_back(primitives.bounds[i]);
+		light_power.push_back(power);
+	}
+
+	light_tree.build(light_bounds, light_power);
+
+	light_cdf.resize(light_power.size());
+	float total = 0.f;
+	for (size_t i = 0; i < light_power.size(); i++)
+		light_cdf[i] = total += light_power[i];
+	for (float& c : light_cdf)
+		c /= total;
+}
+
+//Point on the rectangle at b, c with the texture coords intersectRect would give it
+template <int A, int B, int C>
+static void rect_point(const RectData& rect, float b, float c, HitRecord& rec)
+{
+	rec.position[A] = rect.k;
+	rec.position[B] = b;
+	rec.position[C] = c;
+	rec.normal = Vector3::ZERO;
+	rec.normal[A] = rect.flip_normals ? -1.f : 1.f;
+	rec.u = (b - rect.b0) / (rect.b1 - rect.b0);
+	rec.v = (c - rect.c0) / (rect.c1 - rect.c0);
+}
+
+//Point on the sphere in direction from the center with the texture coords the sphere tests give it
+static void sphere_point(const Vector3& center, float radius, const Vector3& direction, HitRecord& rec)
+{
+	rec.normal = direction;
+	rec.position = center + radius * direction;
+	getSphereUV(rec.position - center, rec.u, rec.v);
+}
+
+bool Scene::sampleLight(float time, const Vector3& position, const Vector3& normal, float select, float u1, float u2,
+                        LightSample& sample) const
+{
+	float pmf;
+	const int index = light_tree.sample(position, normal, select, pmf);
+	if (index < 0)
+		return false;
+
+	pointOnLight(index, time, u1, u2, sample);
+	sample.pdf_area = pmf / lights[index].area;
+	return true;
+}
+
+bool Scene::sampleEmission(float time, float select, float u1, float u2, LightSample& sample) const
+{
+	if (lights.empty())
+		return false;
+
+	int index = 0;
+	while (index + 1 < int(lights.size()) && light_cdf[index] <= select)
+		index++;
+	const float pmf = light_cdf[index] - (index > 0 ? light_cdf[index - 1] : 0.f);
+
+	pointOnLight(index, time, u1, u2, sample);
+	sample.pdf_area = pmf / lights[index].area;
+	return true;
+}
+
+//Point on a light uniformly by area, everything but the density
+void Scene::pointOnLight(int light, float time, float u1, float u2, LightSample& sample) const
+{
+	const PrimitiveRef ref = primitives.refs[lights[light].primitive];
+
+	HitRecord rec;
+	switch (PrimitiveType(ref.type))
+	{
+	case PrimitiveType::Sphere:
+		{
+			const SphereData& sphere = primitives.spheres[ref.index];
+			sphere_point(sphere.center, sphere.radius, sample_uniform_sphere(u1, u2), rec);
+			break;
+		}
+	case PrimitiveType::MovingSphere:
+		{
+			const MovingSphereData& sphere = primitives.moving_spheres[ref.index];
+			sphere_point(MovingSphere::getCenter(sphere, time), sphere.radius, sample_uniform_sphere(u1, u2), rec);
+			break;
+		}
+	default:
+		{
+			const RectData& rect = primitives.rects[ref.index];
+			const float b = rect.b0 + u1 * (rect.b1 - rect.b0);
+			const float c = rect.c0 + u2 * (rect.c1 - rect.c0);
+			if (PrimitiveType(ref.type) == PrimitiveType::XYRect)
+				rect_point<2, 0, 1>(rect, b, c, rec);
+			else if (PrimitiveType(ref.type) == PrimitiveType::XZRect)
+				rect_point<1, 0, 2>(rect, b, c, rec);
+			else
+				rect_point<0, 1, 2>(rect, b, c, rec);
+			break;
+		}
+	}
+
+	rec.mat_ptr = getMaterial(lights[light].primitive);
+	rec.primitive = lights[light].primitive;
+
+	sample.position = rec.position;
+	sample.normal = rec.normal;
+	sample.emitted = rec.mat_ptr->emitted(Ray(), rec);
+}
+
+float Scene::lightPdf(const HitRecord& rec, const Vector3& position, const Vector3& normal) const
+{
+	if (rec.primitive < 0 || rec.primitive >= int(light_of_primitive.size()))
+		return 0.f;
+	const int light = light_of_primitive[rec.primitive];
+	if (light < 0)
+		return 0.f;
+
+	const Vector3 to_light = rec.position - position;
+	const float distance_squared = to_light.dot(to_light);
+	const float cosine = fabsf(rec.normal.dot(to_light)) / sqrtf(distance_squared);
+	if (cosine <= 0.f)
+		return 0.f;
+
+	const float pdf_area = light_tree.pmf(light, position, normal) / lights[light].area;
+	return pdf_area * distance_squared / cosine;
+}
+
+void Scene::appendLights(std::vector<Light>& out) const
+{
+	for (const AreaLight& light : lights)
+	{
+		AABB box = primitives.bounds[light.primitive];
+		const Vector3 center = (box.min + box.max) * 0.5f;
+
+		HitRecord rec;
+		rec.position = center;
+		rec.normal = Vector3::ZERO;
+		rec.u = rec.v = 0.5f;
+		rec.mat_ptr = getMaterial(light.primitive);
+		out.emplace_back(center, box.max - box.min, rec.mat_ptr->emitted(Ray(), rec), LIGHT_POWER);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include "Hitable.h"
+#include "PrimitiveStore.h"
+#include "Light.h"
+#include "LightTree.h"
+
+//A point picked on an emitter for next event estimation
+struct LightSample
+{
+	Vector3 position;
+	Vector3 normal;
+	Vector3 emitted;
+	//Density of picking this point per unit area, including the choice of light
+	float pdf_area;
+};
+
+//Emissive primitive registered when the scene is committed
+struct AreaLight
+{
+	int primitive;
+	float area;
+};
+
+/**
+ * Committed form of a scene that the renderer traces against.
+ * The authoring hierarchy of Hitables is flattened into a PrimitiveStore and a
+ * linear BVH whose leaves index the store directly, so primitive tests are
+ * dispatched with a switch instead of through the Hitable vtable.
+ * Objects without a closed representation are still hit virtually.
+ * Primitives with an emissive material are collected into a light list at commit.
+ */
+class Scene : public Hitable
+{
+public:
+	struct Node
+	{
+		AABB box;
+		//Leaf: first entry in order. Interior: index of the second child, the first child follows the node.
+		int offset;
+		//Number of primitives in a leaf, 0 for interior nodes
+		unsigned short count;
+		//Split axis of interior nodes
+		unsigned short axis;
+	};
+
+	//Leaves never hold more than this, smaller sets are only split when the SAH says it pays off
+	static const int MAX_LEAF_SIZE = 16;
+
+	PrimitiveStore primitives;
+	//Primitive indices in leaf order
+	std::vector<int> order;
+	std::vector<Node> nodes;
+
+	std::vector<AreaLight> lights;
+	//Index into lights for every primitive, -1 for primitives that do not emit
+	std::vector<int> light_of_primitive;
+	//Picks lights by estimated contribution, indices refer to lights
+	LightTree light_tree;
+	//Running sum of the power of lights, normalized to end at 1
+	std::vector<float> light_cdf;
+
+	Scene() = default;
+
+	//Flattens root and builds the BVH over its primitives for the shutter interval [t0, t1]
+	void commit(const Hitable* root, float t0, float t1);
+
+	bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const override;
+	bool bounding_box(float t0, float t1, AABB& b) const override;
+
+	//Whether anything lies along the ray between t_min and t_max
+	bool occluded(const Ray& ray, float t_min, float t_max) const;
+
+	Material* getMaterial(int primitive) const;
+
+	//Picks a light for the point at position with unit normal through the light tree using select,
+	//then a point on that light uniformly by area using u1, u2. Sample values are in [0, 1).
+	bool sampleLight(float time, const Vector3& position, const Vector3& normal, float select, float u1, float u2,
+	                 LightSample& sample) const;
+
+	//Picks a light in proportion to its power using select, then a point on it uniformly by area using u1, u2,
+	//for paths that start on the lights
+	bool sampleEmission(float time, float select, float u1, float u2, LightSample& sample) const;
+
+	//Solid angle density with which sampleLight picks the hit point for the point at position with normal
+	float lightPdf(const HitRecord& rec, const Vector3& position, const Vector3& normal) const;
+
+	//Appends a box light for every registered light, for materials that shade against g_lights
+	void appendLights(std::vector<Light>& out) const;
+
+private:
+	template <bool ANY_HIT>
+	bool traverse(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const;
+	bool hitPrimitive(int primitive, const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const;
+	void collectLights();
+	void pointOnLight(int light, float time, float u1, float u2, LightSample& sample) const;
+	int build(std::vector<int>& indices, int begin, int end, const std::vector<Vector3>& centroids);
+};
@@ -0,0 +1,261 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+#include "Ray.h"
+#include "HitRecord.h"
+#include "Sampler.h"
+#include "Globals.h"
+
+class Material;
+
+//Diffuse bounce remembered for training the path guide
+struct GuideVertex
+{
+	Vector3 position;
+	Vector3 direction;
+	//Density the direction was sampled with
+	float pdf;
+	//Light gathered and throughput of the path just after the bounce
+	Vector3 radiance;
+	Vector3 throughput;
+};
+
+/**
+ * Structure of arrays holding the state of every path in a wavefront.
+ * Paths keep their slot for their whole lifetime, hits and material
+ * bins refer to them by that index.
+ */
+struct PathBatch
+{
+	int size = 0;
+
+	std::vector<float> origin_x, origin_y, origin_z;
+	std::vector<float> direction_x, direction_y, direction_z;
+	std::vector<float> time;
+
+	//Product of the attenuations along the path so far
+	std::vector<float> throughput_r, throughput_g, throughput_b;
+	//Light gathered by the path so far
+	std::vector<float> radiance_r, radiance_g, radiance_b;
+
+	//Solid angle density the last bounce was sampled with, used to weight emission against light sampling
+	std::vector<float> bsdf_pdf;
+	//Whether the last bounce could not have been light sampled, so emission it finds counts in full
+	std::vector<unsigned char> specular;
+	//Surface normal where the last bounce left, light selection depends on it
+	std::vector<float> vertex_normal_x, vertex_normal_y, vertex_normal_z;
+	//Whether emission the path finds is a caustic that g_light_tracer or g_photon_mapper adds instead,
+	//set by the diffuse vertex those can see and kept while every bounce since is specular
+	std::vector<unsigned char> light_traced;
+	//Whether the path has bounced off a diffuse surface yet
+	std::vector<unsigned char> diffuse_seen;
+
+	std::vector<int> depth;
+	std::vector<unsigned char> alive;
+
+	//Guide buffer values of the first surface the path found that is not specular
+	std::vector<float> guide_albedo_r, guide_albedo_g, guide_albedo_b;
+	std::vector<float> guide_normal_x, guide_normal_y, guide_normal_z;
+	//Length of the path up to that surface, mirrors and glass unfolded, it grows until the surface is found
+	std::vector<float> guide_depth;
+	//Primitive of that surface in the committed scene
+	std::vector<int> guide_id;
+	std::vector<unsigned char> guide_found;
+
+	//Key of the path in g_sampler, bounce dimensions start at first_dimension
+	std::vector<int> pixel;
+	std::vector<unsigned int> sample;
+	std::vector<int> first_dimension;
+
+	//Bounces recorded for the path guide, GUIDE_VERTICES per path
+	static const int GUIDE_VERTICES = 8;
+	std::vector<GuideVertex> guide_vertices;
+	std::vector<int> guide_vertex_count;
+
+	void resize(int n)
+	{
+		size = n;
+		for (auto* a : {
+			     &origin_x, &origin_y, &origin_z, &direction_x, &direction_y, &direction_z, &time,
+			     &throughput_r, &throughput_g, &throughput_b, &radiance_r, &radiance_g, &radiance_b, &bsdf_pdf,
+			     &vertex_normal_x, &vertex_normal_y, &vertex_normal_z, &guide_albedo_r, &guide_albedo_g, &guide_albedo_b,
+			     &guide_normal_x, &guide_normal_y, &guide_normal_z, &guide_depth
+		     })
+			a->resize(n);
+		specular.resize(n);
+		light_traced.resize(n);
+		diffuse_seen.resize(n);
+		depth.resize(n);
+		alive.resize(n);
+		guide_id.resize(n);
+		guide_found.resize(n);
+		pixel.resize(n);
+		sample.resize(n);
+		first_dimension.resize(n);
+		guide_vertices.resize(size_t(n) * GUIDE_VERTICES);
+		guide_vertex_count.resize(n);
+	}
+
+	void start(int i, const Ray& ray)
+	{
+		setRay(i, ray);
+		time[i] = ray.time;
+		throughput_r[i] = throughput_g[i] = throughput_b[i] = 1.f;
+		radiance_r[i] = radiance_g[i] = radiance_b[i] = 0.f;
+		bsdf_pdf[i] = 0.f;
+		specular[i] = 1;
+		light_traced[i] = 0;
+		diffuse_seen[i] = 0;
+		depth[i] = 0;
+		alive[i] = 1;
+		guide_vertex_count[i] = 0;
+		guide_albedo_r[i] = guide_albedo_g[i] = guide_albedo_b[i] = 0.f;
+		guide_normal_x[i] = guide_normal_y[i] = guide_normal_z[i] = 0.f;
+		guide_depth[i] = 0.f;
+		guide_id[i] = -1;
+		guide_found[i] = 0;
+	}
+
+	//Makes the surface hit by path i its guide buffer values
+	void setGuides(int i, const Vector3& albedo, const Vector3& normal, int id)
+	{
+		guide_albedo_r[i] = albedo.r;
+		guide_albedo_g[i] = albedo.g;
+		guide_albedo_b[i] = albedo.b;
+		guide_normal_x[i] = normal.x;
+		guide_normal_y[i] = normal.y;
+		guide_normal_z[i] = normal.z;
+		guide_id[i] = id;
+		guide_found[i] = 1;
+	}
+
+	Vector3 getGuideAlbedo(int i) const
+	{
+		return {guide_albedo_r[i], guide_albedo_g[i], guide_albedo_b[i]};
+	}
+
+	Vector3 getGuideNormal(int i) const
+	{
+		return {guide_normal_x[i], guide_normal_y[i], guide_normal_z[i]};
+	}
+
+	void addGuideVertex(int i, const Vector3& position, const Vector3& direction, float pdf)
+	{
+		if (guide_vertex_count[i] == GUIDE_VERTICES)
+			return;
+		guide_vertices[i * GUIDE_VERTICES + guide_vertex_count[i]++] =
+			GuideVertex{position, direction, pdf, getRadiance(i), getThroughput(i)};
+	}
+
+	//Sample value for a dimension of the current bounce of path i
+	float getSample(int i, Sampler::BounceDimension dimension) const
+	{
+		return g_sampler->get(pixel[i], sample[i], first_dimension[i] + depth[i] * Sampler::BounceDimensions + dimension);
+	}
+
+	Ray getRay(int i) const
+	{
+		return Ray({origin_x[i], origin_y[i], origin_z[i]}, {direction_x[i], direction_y[i], direction_z[i]}, time[i]);
+	}
+
+	void setRay(int i, const Ray& ray)
+	{
+		setRay(i, ray.origin, ray.direction);
+	}
+
+	void setRay(int i, const Vector3& origin, const Vector3& direction)
+	{
+		origin_x[i] = origin.x;
+		origin_y[i] = origin.y;
+		origin_z[i] = origin.z;
+		direction_x[i] = direction.x;
+		direction_y[i] = direction.y;
+		direction_z[i] = direction.z;
+	}
+
+	Vector3 getThroughput(int i) const
+	{
+		return {throughput_r[i], throughput_g[i], throughput_b[i]};
+	}
+
+	void attenuate(int i, const Vector3& attenuation)
+	{
+		throughput_r[i] *= attenuation.r;
+		throughput_g[i] *= attenuation.g;
+		throughput_b[i] *= attenuation.b;
+	}
+
+	//Adds light reaching the path vertex, weighted by the path throughput
+	void addRadiance(int i, const Vector3& light)
+	{
+		radiance_r[i] += throughput_r[i] * light.r;
+		radiance_g[i] += throughput_g[i] * light.g;
+		radiance_b[i] += throughput_b[i] * light.b;
+	}
+
+	Vector3 getRadiance(int i) const
+	{
+		return {radiance_r[i], radiance_g[i], radiance_b[i]};
+	}
+};
+
+
+/**
+ * Structure of arrays holding the closest hit of each path in a wavefront,
+ * indexed by the same slot as the path it belongs to.
+ */
+struct HitBatch
+{
+	std::vector<float> t;
+	std::vector<float> position_x, position_y, position_z;
+	std::vector<float> normal_x, normal_y, normal_z;
+	std::vector<float> u, v;
+	std::vector<Material*> material;
+	std::vector<int> primitive;
+
+	void resize(int n)
+	{
+		for (auto* a : {&t, &position_x, &position_y, &position_z, &normal_x, &normal_y, &normal_z, &u, &v})
+			a->resize(n);
+		material.resize(n);
+		primitive.resize(n);
+	}
+
+	void set(int i, const HitRecord& rec)
+	{
+		t[i] = rec.t;
+		position_x[i] = rec.position.x;
+		position_y[i] = rec.position.y;
+		position_z[i] = rec.position.z;
+		normal_x[i] = rec.normal.x;
+		normal_y[i] = rec.normal.y;
+		normal_z[i] = rec.normal.z;
+		u[i] = rec.u;
+		v[i] = rec.v;
+		material[i] = rec.mat_ptr;
+		primitive[i] = rec.primitive;
+	}
+
+	HitRecord get(int i) const
+	{
+		HitRecord rec;
+		rec.t = t[i];
+		rec.position = getPosition(i);
+		rec.normal = getNormal(i);
+		rec.u = u[i];
+		rec.v = v[i];
+		rec.mat_ptr = material[i];
+		rec.primitive = primitive[i];
+		return rec;
+	}
+
+	Vector3 getPosition(int i) const
+	{
+		return {position_x[i], position_y[i], position_z[i]};
+	}
+
+	Vector3 getNormal(int i) const
+	{
+		return {normal_x[i], normal_y[i], normal_z[i]};
+	}
+};
@@ -0,0 +1,229 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+
+/**
+ * Lanes of 32 bit integers and floats in the widest registers the build targets: 16 with
+ * AVX-512, 8 with AVX2 and otherwise 8 in plain arrays the compiler is free to vectorise.
+ * Only the operations the vectorised kernels need are wrapped.
+ */
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+#define SIMD_LANES 16
+typedef __m512i simd_u32;
+
+inline simd_u32 simd_set(uint32_t a) { return _mm512_set1_epi32(int(a)); }
+//first, first + 1, ... in consecutive lanes
+inline simd_u32 simd_ramp(uint32_t first)
+{
+	return _mm512_add_epi32(_mm512_set1_epi32(int(first)),
+	                        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+inline simd_u32 simd_load(const uint32_t* p) { return _mm512_loadu_si512(p); }
+inline void simd_store(uint32_t* p, simd_u32 a) { _mm512_storeu_si512(p, a); }
+inline simd_u32 simd_add(simd_u32 a, simd_u32 b) { return _mm512_add_epi32(a, b); }
+inline simd_u32 simd_mul(simd_u32 a, simd_u32 b) { return _mm512_mullo_epi32(a, b); }
+inline simd_u32 simd_xor(simd_u32 a, simd_u32 b) { return _mm512_xor_si512(a, b); }
+inline simd_u32 simd_shift_right(simd_u32 a, int bits) { return _mm512_srli_epi32(a, bits); }
+inline simd_u32 simd_shift_left(simd_u32 a, int bits) { return _mm512_slli_epi32(a, bits); }
+inline simd_u32 simd_or(simd_u32 a, simd_u32 b) { return _mm512_or_si512(a, b); }
+
+typedef __m512 simd_f32;
+
+inline simd_f32 simd_set(float a) { return _mm512_set1_ps(a); }
+inline simd_f32 simd_load(const float* p) { return _mm512_loadu_ps(p); }
+//p[0], p[stride], p[2 * stride], ... in consecutive lanes
+inline simd_f32 simd_load_strided(const float* p, int stride)
+{
+	return _mm512_i32gather_ps(_mm512_mullo_epi32(simd_ramp(0), _mm512_set1_epi32(stride)), p, 4);
+}
+//p[index] of each lane
+inline simd_f32 simd_gather(const float* p, simd_u32 index) { return _mm512_i32gather_ps(index, p, 4); }
+inline void simd_store(float* p, simd_f32 a) { _mm512_storeu_ps(p, a); }
+inline simd_f32 simd_add(simd_f32 a, simd_f32 b) { return _mm512_add_ps(a, b); }
+inline simd_f32 simd_sub(simd_f32 a, simd_f32 b) { return _mm512_sub_ps(a, b); }
+inline simd_f32 simd_mul(simd_f32 a, simd_f32 b) { return _mm512_mul_ps(a, b); }
+inline simd_f32 simd_div(simd_f32 a, simd_f32 b) { return _mm512_div_ps(a, b); }
+inline simd_f32 simd_min(simd_f32 a, simd_f32 b) { return _mm512_min_ps(a, b); }
+inline simd_f32 simd_max(simd_f32 a, simd_f32 b) { return _mm512_max_ps(a, b); }
+inline simd_f32 simd_sqrt(simd_f32 a) { return _mm512_sqrt_ps(a); }
+//Truncates towards zero
+inline simd_u32 simd_to_u32(simd_f32 a) { return _mm512_cvttps_epi32(a); }
+
+#elif defined(__AVX2__)
+#include <immintrin.h>
+
+#define SIMD_LANES 8
+typedef __m256i simd_u32;
+
+inline simd_u32 simd_set(uint32_t a) { return _mm256_set1_epi32(int(a)); }
+inline simd_u32 simd_ramp(uint32_t first)
+{
+	return _mm256_add_epi32(_mm256_set1_epi32(int(first)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+inline simd_u32 simd_load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline void simd_store(uint32_t* p, simd_u32 a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+inline simd_u32 simd_add(simd_u32 a, simd_u32 b) { return _mm256_add_epi32(a, b); }
+inline simd_u32 simd_mul(simd_u32 a, simd_u32 b) { return _mm256_mullo_epi32(a, b); }
+inline simd_u32 simd_xor(simd_u32 a, simd_u32 b) { return _mm256_xor_si256(a, b); }
+inline simd_u32 simd_shift_right(simd_u32 a, int bits) { return _mm256_srli_epi32(a, bits); }
+inline simd_u32 simd_shift_left(simd_u32 a, int bits) { return _mm256_slli_epi32(a, bits); }
+inline simd_u32 simd_or(simd_u32 a, simd_u32 b) { return _mm256_or_si256(a, b); }
+
+typedef __m256 simd_f32;
+
+inline simd_f32 simd_set(float a) { return _mm256_set1_ps(a); }
+inline simd_f32 simd_load(const float* p) { return _mm256_loadu_ps(p); }
+inline simd_f32 simd_load_strided(const float* p, int stride)
+{
+	return _mm256_i32gather_ps(p, _mm256_mullo_epi32(simd_ramp(0), _mm256_set1_epi32(stride)), 4);
+}
+inline simd_f32 simd_gather(const float* p, simd_u32 index) { return _mm256_i32gather_ps(p, index, 4); }
+inline void simd_store(float* p, simd_f32 a) { _mm256_storeu_ps(p, a); }
+inline simd_f32 simd_add(simd_f32 a, simd_f32 b) { return _mm256_add_ps(a, b); }
+inline simd_f32 simd_sub(simd_f32 a, simd_f32 b) { return _mm256_sub_ps(a, b); }
+inline simd_f32 simd_mul(simd_f32 a, simd_f32 b) { return _mm256_mul_ps(a, b); }
+inline simd_f32 simd_div(simd_f32 a, simd_f32 b) { return _mm256_div_ps(a, b); }
+inline simd_f32 simd_min(simd_f32 a, simd_f32 b) { return _mm256_min_ps(a, b); }
+inline simd_f32 simd_max(simd_f32 a, simd_f32 b) { return _mm256_max_ps(a, b); }
+inline simd_f32 simd_sqrt(simd_f32 a) { return _mm256_sqrt_ps(a); }
+inline simd_u32 simd_to_u32(simd_f32 a) { return _mm256_cvttps_epi32(a); }
+
+#else
+
+#define SIMD_LANES 8
+struct simd_u32
+{
+	uint32_t lane[SIMD_LANES];
+};
+
+inline simd_u32 simd_set(uint32_t a)
+{
+	simd_u32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = a;
+	return r;
+}
+inline simd_u32 simd_ramp(uint32_t first)
+{
+	simd_u32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = first + uint32_t(i);
+	return r;
+}
+inline simd_u32 simd_load(const uint32_t* p)
+{
+	simd_u32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = p[i];
+	return r;
+}
+inline void simd_store(uint32_t* p, simd_u32 a)
+{
+	for (int i = 0; i < SIMD_LANES; i++) p[i] = a.lane[i];
+}
+inline simd_u32 simd_add(simd_u32 a, simd_u32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] += b.lane[i];
+	return a;
+}
+inline simd_u32 simd_mul(simd_u32 a, simd_u32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] *= b.lane[i];
+	return a;
+}
+inline simd_u32 simd_xor(simd_u32 a, simd_u32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] ^= b.lane[i];
+	return a;
+}
+inline simd_u32 simd_shift_right(simd_u32 a, int bits)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] >>= bits;
+	return a;
+}
+inline simd_u32 simd_shift_left(simd_u32 a, int bits)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] <<= bits;
+	return a;
+}
+inline simd_u32 simd_or(simd_u32 a, simd_u32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] |= b.lane[i];
+	return a;
+}
+
+struct simd_f32
+{
+	float lane[SIMD_LANES];
+};
+
+inline simd_f32 simd_set(float a)
+{
+	simd_f32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = a;
+	return r;
+}
+inline simd_f32 simd_load(const float* p)
+{
+	simd_f32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = p[i];
+	return r;
+}
+inline simd_f32 simd_load_strided(const float* p, int stride)
+{
+	simd_f32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = p[i * stride];
+	return r;
+}
+inline simd_f32 simd_gather(const float* p, simd_u32 index)
+{
+	simd_f32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = p[index.lane[i]];
+	return r;
+}
+inline void simd_store(float* p, simd_f32 a)
+{
+	for (int i = 0; i < SIMD_LANES; i++) p[i] = a.lane[i];
+}
+inline simd_f32 simd_add(simd_f32 a, simd_f32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] += b.lane[i];
+	return a;
+}
+inline simd_f32 simd_sub(simd_f32 a, simd_f32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] -= b.lane[i];
+	return a;
+}
+inline simd_f32 simd_mul(simd_f32 a, simd_f32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] *= b.lane[i];
+	return a;
+}
+inline simd_f32 simd_div(simd_f32 a, simd_f32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] /= b.lane[i];
+	return a;
+}
+inline simd_f32 simd_min(simd_f32 a, simd_f32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] = a.lane[i] < b.lane[i] ? a.lane[i] : b.lane[i];
+	return a;
+}
+inline simd_f32 simd_max(simd_f32 a, simd_f32 b)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] = a.lane[i] > b.lane[i] ? a.lane[i] : b.lane[i];
+	return a;
+}
+inline simd_f32 simd_sqrt(simd_f32 a)
+{
+	for (int i = 0; i < SIMD_LANES; i++) a.lane[i] = sqrtf(a.lane[i]);
+	return a;
+}
+inline simd_u32 simd_to_u32(simd_f32 a)
+{
+	simd_u32 r;
+	for (int i = 0; i < SIMD_LANES; i++) r.lane[i] = uint32_t(a.lane[i]);
+	return r;
+}
+
+#endif
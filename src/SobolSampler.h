@@ -0,0 +1,49 @@
+#pragma once
+#include "Sampler.h"
+
+/**
+ * Owen scrambled Sobol points. Dimensions are taken in pairs from the first two
+ * Sobol dimensions, which form a (0,2) sequence. Each pair gets its own index
+ * shuffle and scramble, so pairs stay well stratified and independent of each other.
+ * Scrambles are seeded by pixel, so neighbouring pixels are decorrelated.
+ */
+class SobolSampler : public Sampler
+{
+public:
+	float get(int pixel, unsigned int sample, int dimension) const override
+	{
+		const uint32_t seed = hash(uint32_t(pixel), uint32_t(dimension >> 1));
+		const uint32_t index = nestedUniformScramble(sample, seed);
+		const uint32_t value = sobol(index, dimension & 1);
+		return toFloat(nestedUniformScramble(value, hash(seed, uint32_t(dimension))));
+	}
+
+	//Dimension 0 or 1 of the Sobol sequence as 32 bit fixed point
+	static uint32_t sobol(uint32_t index, int dimension)
+	{
+		if (dimension == 0)
+			return reverseBits(index);
+
+		uint32_t direction = 1U << 31;
+		uint32_t result = 0;
+		for (; index != 0; index >>= 1)
+		{
+			if (index & 1U)
+				result ^= direction;
+			direction ^= direction >> 1;
+		}
+		return result;
+	}
+
+	//Owen scramble with a hash based permutation, the bits are reversed so higher bits flip lower ones
+	static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+	{
+		x = reverseBits(x);
+		x += seed;
+		x ^= x * 0x6c50b47cU;
+		x ^= x * 0xb82f1e52U;
+		x ^= x * 0xc7afe638U;
+		x ^= x * 0x8d22f6e6U;
+		return reverseBits(x);
+	}
+};
@@ -6,7 +6,7 @@
 #include "Material.h"
 #include "AABB.h"
 
-void getSphereUV(const Vector3& p, float& u, float& v);
+inline void getSphereUV(const Vector3& p, float& u, float& v);
 
 class Sphere : public Hitable
 {
@@ -30,12 +30,26 @@ public:
 	bool hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const override;
 	bool bounding_box(float t0, float t1, AABB& box) const override;
 
+	void flatten(PrimitiveStore& store) const override
+	{
+		AABB box;
+		bounding_box(store.time0, store.time1, box);
+		store.add(SphereData{center, radius, mat_ptr}, box);
+	}
+
+	static bool intersect(const SphereData& sphere, const Ray& ray, float t_min, float t_max, HitRecord& hit_record);
+
 
 private:
 	bool sphereIntersectionMethod1(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const;
 };
 
 inline bool Sphere::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit_record) const
+{
+	return intersect(SphereData{center, radius, mat_ptr}, ray, t_min, t_max, hit_record);
+}
+
+inline bool Sphere::intersect(const SphereData& sphere, const Ray& ray, float t_min, float t_max, HitRecord& hit_record)
 {
 	//https://en.wikipedia.org/wiki/Line%E2%80%93sphere_intersection
 	//Equation of Sphere
@@ -63,11 +77,11 @@ inline bool Sphere::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit
 	// c = (origin-center) * (origin-center) - radius^2
 
 	HitRecord temp;
-	Vector3 oc = ray.origin - center;
+	Vector3 oc = ray.origin - sphere.center;
 
 	float a = ray.direction.dot(ray.direction);
 	float b = ray.direction.dot(oc);
-	float c = oc.dot(oc) - radius * radius;
+	float c = oc.dot(oc) - sphere.radius * sphere.radius;
 
 	//Use quadratic formula
 	// (-b +- sqrt(b^2 - 4ac)) / 2a
@@ -88,10 +102,10 @@ inline bool Sphere::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit
 		{
 			temp.t = t0;
 			temp.position = ray.point_at_parameter(t0);
-			temp.normal = (temp.position - center) / radius;
-			temp.mat_ptr = mat_ptr;
+			temp.normal = (temp.position - sphere.center) / sphere.radius;
+			temp.mat_ptr = sphere.mat_ptr;
 			float u, v;
-			getSphereUV(temp.position - center, u, v);
+			getSphereUV(temp.position - sphere.center, u, v);
 			temp.u = u;
 			temp.v = v;
 			hit_record = temp;
@@ -103,10 +117,10 @@ inline bool Sphere::hit(const Ray& ray, float t_min, float t_max, HitRecord& hit
 		{
 			temp.t = t1;
 			temp.position = ray.point_at_parameter(t1);
-			temp.normal = (temp.position - center) / radius;
-			temp.mat_ptr = mat_ptr;
+			temp.normal = (temp.position - sphere.center) / sphere.radius;
+			temp.mat_ptr = sphere.mat_ptr;
 			float u, v;
-			getSphereUV(temp.position - center, u, v);
+			getSphereUV(temp.position - sphere.center, u, v);
 			temp.u = u;
 			temp.v = v;
 			hit_record = temp;
@@ -171,10 +185,10 @@ inline bool Sphere::sphereIntersectionMethod1(const Ray& ray, float t_min, float
 }
 
 
-void getSphereUV(const Vector3& p, float& u, float& v)
+inline void getSphereUV(const Vector3& p, float& u, float& v)
 {
 	float phi = atan2(p.z, p.x);
 	float theta = asin(p.y);
-	u = 1.f - (phi + float(M_PI)) / (2.f / float(M_PI));
-	v = (theta + float(M_PI) / 2.f) / float(M_PI);
+	u = 1.f - (phi + PI) / (2.f / PI);
+	v = (theta + PI / 2.f) / PI;
 }
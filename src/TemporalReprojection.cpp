@@ -0,0 +1,151 @@
+#include "TemporalReprojection.h"
+#include "AccumulationBuffer.h"
+#include "PrimaryCache.h"
+#include "SampleScheduler.h"
+#include "Material.h"
+#include <cmath>
+
+void TemporalReprojection::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	distance.assign(width * height, -1.f);
+	next_distance.resize(width * height);
+	max_history.resize(width * height);
+	source.resize(width * height);
+}
+
+void TemporalReprojection::setView(const Camera& camera, const Hitable* world)
+{
+	view = camera;
+	traceDistances(camera, world, 1, distance);
+}
+
+Ray TemporalReprojection::centreRay(const Camera& camera, int x, int y) const
+{
+	return camera.getRay((float(x) + 0.5f) / float(width), (float(y) + 0.5f) / float(height), 0.5f, 0.5f, 0.5f);
+}
+
+void TemporalReprojection::traceDistances(const Camera& camera, const Hitable* world, int stride, std::vector<float>& out)
+{
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int row = 0; row < height; row += stride)
+	{
+		const int y = height - row - 1;
+		for (int x = 0; x < width; x += stride)
+		{
+			PrimaryCache::Entry entry;
+			PrimaryCache::traceMirrorChain(entry, centreRay(camera, x, y), world);
+			const int pixel = row * width + x;
+			out[pixel] = entry.has_vertex ? entry.distance : -1.f;
+			max_history[pixel] = entry.has_vertex && entry.hit.mat_ptr->type == MaterialType::Dialectric
+				                     ? MAX_REFRACTED_HISTORY
+				                     : MAX_HISTORY;
+		}
+	}
+}
+
+void TemporalReprojection::fillDistances(int stride, std::vector<float>& out)
+{
+	const int last_column = (width - 1) / stride * stride;
+	const int last_row = (height - 1) / stride * stride;
+
+#pragma omp parallel for
+	for (int row = 0; row < height; row++)
+	{
+		const int top = row - row % stride;
+		const int bottom = top + stride <= last_row ? top + stride : top;
+		const float bottom_weight = bottom > top ? float(row - top) / float(stride) : 0.f;
+		for (int x = 0; x < width; x++)
+		{
+			if (row == top && x % stride == 0)
+				continue;
+			const int left = x - x % stride;
+			const int right = left + stride <= last_column ? left + stride : left;
+			const float right_weight = right > left ? float(x - left) / float(stride) : 0.f;
+			const int corners[4] = {top * width + left, top * width + right, bottom * width + left, bottom * width + right};
+
+			//Only surfaces all four grid pixels agree on are interpolated, across an edge nothing is known
+			const int pixel = row * width + x;
+			float nearest = out[corners[0]], furthest = out[corners[0]];
+			int history = max_history[corners[0]];
+			for (int c = 1; c < 4; c++)
+			{
+				nearest = out[corners[c]] < nearest ? out[corners[c]] : nearest;
+				furthest = out[corners[c]] > furthest ? out[corners[c]] : furthest;
+				history = max_history[corners[c]] < history ? max_history[corners[c]] : history;
+			}
+			max_history[pixel] = history;
+			if (nearest < 0.f || furthest - nearest > DEPTH_TOLERANCE * nearest)
+			{
+				out[pixel] = -1.f;
+				continue;
+			}
+			const float upper = out[corners[0]] + (out[corners[1]] - out[corners[0]]) * right_weight;
+			const float lower = out[corners[2]] + (out[corners[3]] - out[corners[2]]) * right_weight;
+			out[pixel] = upper + (lower - upper) * bottom_weight;
+		}
+	}
+}
+
+int TemporalReprojection::project(const Vector3& point) const
+{
+	//w points backwards out of the camera
+	const Vector3 to_point = point - view.position;
+	const float depth = -to_point.dot(view.w);
+	if (depth <= 0.f)
+		return -1;
+
+	const float image_x = (to_point.dot(view.u) / depth / view.half_width + 1.f) * 0.5f;
+	const float image_y = (to_point.dot(view.v) / depth / view.half_height + 1.f) * 0.5f;
+	if (image_x < 0.f || image_x >= 1.f || image_y < 0.f || image_y >= 1.f)
+		return -1;
+
+	const int x = int(image_x * float(width));
+	const int y = int(image_y * float(height));
+	return (height - y - 1) * width + x;
+}
+
+int TemporalReprojection::reproject(const Camera& camera, const Hitable* world, int stride, AccumulationBuffer& accumulation,
+                                    SampleScheduler& scheduler)
+{
+	traceDistances(camera, world, stride, next_distance);
+	if (stride > 1)
+		fillDistances(stride, next_distance);
+
+	int kept = 0;
+#pragma omp parallel for reduction(+:kept)
+	for (int row = 0; row < height; row++)
+	{
+		const int y = height - row - 1;
+		for (int x = 0; x < width; x++)
+		{
+			const int pixel = row * width + x;
+			source[pixel] = -1;
+			if (next_distance[pixel] < 0.f)
+				continue;
+
+			//Mirrors are unfolded, the point lies where the reflection appears to be
+			const Ray ray = centreRay(camera, x, y);
+			const Vector3 point = ray.origin + ray.direction.getNormalized() * next_distance[pixel];
+			const int from = project(point);
+			if (from < 0 || distance[from] < 0.f)
+				continue;
+
+			//The previous pixel saw something nearer or further away, the point was hidden from it
+			const float seen_from = (point - view.position).length();
+			if (fabsf(distance[from] - seen_from) > DEPTH_TOLERANCE * seen_from)
+				continue;
+
+			source[pixel] = from;
+			kept++;
+		}
+	}
+
+	scheduler.reproject(source, max_history);
+	accumulation.reproject(source, scheduler);
+
+	view = camera;
+	distance.swap(next_distance);
+	return kept;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include "Vector3.h"
+#include "Camera.h"
+
+class Hitable;
+class SampleScheduler;
+class AccumulationBuffer;
+
+/**
+ * Keeps the accumulated image when the camera moves instead of starting over.
+ * The surface seen through the centre of every pixel is found by following the camera
+ * ray through perfect mirrors, so reflections in them move with what they reflect.
+ * After a move each pixel looks up where its surface was in the previous view and takes
+ * over the mean and sample count of that pixel, unless the previous pixel saw something
+ * at a different distance there, which means the surface was hidden or off screen.
+ * Right after a move only the pixels on the grid the frame samples are traced, the distances
+ * of the others are interpolated from them where the grid pixels around agree.
+ */
+class TemporalReprojection
+{
+public:
+	//Most samples a reprojected pixel keeps, so shading that changed with the view fades out quickly
+	static const int MAX_HISTORY = 32;
+	//Most samples kept by pixels looking through glass, what they show moves differently from the glass
+	static const int MAX_REFRACTED_HISTORY = 4;
+	//Relative difference in distance beyond which the previous pixel saw another surface
+	static constexpr float DEPTH_TOLERANCE = 0.05f;
+
+	void resize(int width, int height);
+
+	//Finds the surfaces of the view accumulation starts from
+	void setView(const Camera& camera, const Hitable* world);
+
+	//Moves the accumulation in accumulation and scheduler from the last view to camera,
+	//pixels without a match start over. Only every stride-th pixel of every stride-th row is traced.
+	//Returns the number of pixels kept.
+	int reproject(const Camera& camera, const Hitable* world, int stride, AccumulationBuffer& accumulation,
+	              SampleScheduler& scheduler);
+
+	//Pixel of the previous view each pixel took its history from in the last reprojection, -1 for none
+	const std::vector<int>& getSource() const
+	{
+		return source;
+	}
+
+	//Distance behind each pixel of the current view, negative where the camera ray escaped
+	const std::vector<float>& getDistance() const
+	{
+		return distance;
+	}
+
+private:
+	int width = 0, height = 0;
+	Camera view;
+
+	//Distance to the surface behind each pixel of view, negative where the camera ray escaped
+	std::vector<float> distance;
+	std::vector<float> next_distance;
+	//Samples each pixel of view may keep when it is reprojected
+	std::vector<int> max_history;
+	//Pixel of the previous view each pixel takes its history from, -1 for none
+	std::vector<int> source;
+
+	//Point the camera ray through the centre of the pixel at x, y from the bottom left sees
+	Ray centreRay(const Camera& camera, int x, int y) const;
+	//Fills out with the distance behind every pixel of camera on the grid of stride and max_history with
+	//what they may keep
+	void traceDistances(const Camera& camera, const Hitable* world, int stride, std::vector<float>& out);
+	//Interpolates out and max_history between the pixels on the grid of stride, -1 where they disagree
+	void fillDistances(int stride, std::vector<float>& out);
+	//Pixel of view that point lands in, -1 when it is behind the camera or off screen
+	int project(const Vector3& point) const;
+};
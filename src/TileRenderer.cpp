@@ -0,0 +1,45 @@
+#include "TileRenderer.h"
+
+//Splits a Morton code back into x from the even bits and y from the odd bits
+static void morton_decode(unsigned int code, unsigned int& x, unsigned int& y)
+{
+	x = y = 0;
+	for (int bit = 0; bit < 16; bit++)
+	{
+		x |= ((code >> (2 * bit)) & 1U) << bit;
+		y |= ((code >> (2 * bit + 1)) & 1U) << bit;
+	}
+}
+
+void TileRenderer::resize(int width, int height)
+{
+	const int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	//Walks the codes of the enclosing power of two square and skips those outside the frame
+	int side = 1;
+	while (side < tiles_x || side < tiles_y)
+		side <<= 1;
+
+	tiles.clear();
+	for (int code = 0; code < side * side; code++)
+	{
+		unsigned int tx, ty;
+		morton_decode(unsigned(code), tx, ty);
+		if (int(tx) >= tiles_x || int(ty) >= tiles_y)
+			continue;
+
+		const int x0 = int(tx) * TILE_SIZE, y0 = int(ty) * TILE_SIZE;
+		tiles.push_back(Tile{
+			x0, y0, x0 + TILE_SIZE < width ? x0 + TILE_SIZE : width, y0 + TILE_SIZE < height ? y0 + TILE_SIZE : height
+		});
+	}
+}
+
+void TileRenderer::printStats(std::ostream& out) const
+{
+	out << "threads busy/idle ms:";
+	for (const ThreadStats& thread : stats)
+		out << " " << int(thread.busy_ms) << "/" << int(thread.idle_ms);
+	out << "\n";
+}
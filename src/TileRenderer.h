@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <ostream>
+#include <omp.h>
+#include "PerformanceCounter.h"
+
+/**
+ * Splits the frame into square tiles visited in Morton order, so tiles handed out one after
+ * another lie close together on screen and touch the same parts of the scene and framebuffer.
+ * Threads take the next tile from an atomic counter until none are left, which keeps them
+ * all busy however unevenly the work is spread, and time how long they spent on tiles.
+ */
+class TileRenderer
+{
+public:
+	static const int TILE_SIZE = 16;
+
+	//Pixel bounds of a tile in framebuffer rows, top down, end exclusive
+	struct Tile
+	{
+		int x0, y0, x1, y1;
+	};
+
+	struct ThreadStats
+	{
+		double busy_ms;
+		double idle_ms;
+		int tiles;
+	};
+
+	void resize(int width, int height);
+
+	//Calls render_tile(tile) once for every tile, spread over all threads
+	template <typename F>
+	void render(F render_tile);
+
+	//Busy and idle time of every thread in the last frame
+	const std::vector<ThreadStats>& getStats() const
+	{
+		return stats;
+	}
+
+	void printStats(std::ostream& out) const;
+
+private:
+	std::vector<Tile> tiles;
+	std::atomic<int> next_tile{0};
+	std::vector<ThreadStats> stats;
+};
+
+template <typename F>
+void TileRenderer::render(F render_tile)
+{
+	next_tile = 0;
+	stats.assign(omp_get_max_threads(), ThreadStats{0.0, 0.0, 0});
+
+	PerformanceCounter frame{};
+	frame.start();
+#pragma omp parallel
+	{
+		ThreadStats& thread = stats[omp_get_thread_num()];
+		PerformanceCounter busy{};
+		for (int t = next_tile++; t < int(tiles.size()); t = next_tile++)
+		{
+			busy.start();
+			render_tile(tiles[t]);
+			thread.busy_ms += busy.getCounter();
+			thread.tiles++;
+		}
+	}
+
+	//Whatever a thread did not spend on tiles it spent waiting for the others
+	const double frame_ms = frame.getCounter();
+	for (ThreadStats& thread : stats)
+		thread.idle_ms = frame_ms - thread.busy_ms;
+}
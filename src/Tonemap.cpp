@@ -0,0 +1,85 @@
+#include "Tonemap.h"
+#include "Simd.h"
+
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Tonemapping reads Vector3 arrays as interleaved floats");
+
+namespace
+{
+	//Scales a display color in [0, 1] to 8 bits, rounding down like the rest of the display code
+	simd_u32 quantise(simd_f32 c)
+	{
+		c = simd_min(simd_max(simd_mul(c, simd_set(255.9f)), simd_set(0.f)), simd_set(255.f));
+		return simd_to_u32(c);
+	}
+
+	/**
+	 * Runs curve over the channels of SIMD_LANES colors at a time and packs the results.
+	 * The channels are gathered out of the interleaved Vector3s, the tail that does not fill
+	 * the lanes is copied into a padded block so every pixel goes through the same code.
+	 */
+	template <typename Curve>
+	void tonemap(const Vector3* in, uint32_t* out, int count, Curve curve)
+	{
+		const simd_u32 alpha = simd_set(255U);
+		uint32_t packed[SIMD_LANES];
+		for (int i = 0; i < count; i += SIMD_LANES)
+		{
+			const int lanes = count - i < SIMD_LANES ? count - i : SIMD_LANES;
+			const float* block = in[i].data;
+			float tail[3 * SIMD_LANES] = {};
+			if (lanes < SIMD_LANES)
+			{
+				for (int j = 0; j < lanes; j++)
+					for (int c = 0; c < 3; c++)
+						tail[j * 3 + c] = in[i + j].data[c];
+				block = tail;
+			}
+
+			const simd_u32 r = quantise(curve(simd_load_strided(block, 3)));
+			const simd_u32 g = quantise(curve(simd_load_strided(block + 1, 3)));
+			const simd_u32 b = quantise(curve(simd_load_strided(block + 2, 3)));
+			const simd_u32 rgba = simd_or(simd_or(simd_shift_left(r, 24), simd_shift_left(g, 16)),
+			                              simd_or(simd_shift_left(b, 8), alpha));
+			if (lanes == SIMD_LANES)
+				simd_store(out + i, rgba);
+			else
+			{
+				simd_store(packed, rgba);
+				for (int j = 0; j < lanes; j++)
+					out[i + j] = packed[j];
+			}
+		}
+	}
+}
+
+void FilmicToneOperator::apply(const Vector3* in, uint32_t* out, int count) const
+{
+	tonemap(in, out, count, [](simd_f32 c)
+	{
+		const simd_f32 x = simd_max(simd_sub(c, simd_set(0.004f)), simd_set(0.f));
+		const simd_f32 x62 = simd_mul(simd_set(6.2f), x);
+		return simd_div(simd_mul(x, simd_add(x62, simd_set(0.5f))),
+		                simd_add(simd_mul(x, simd_add(x62, simd_set(1.7f))), simd_set(0.06f)));
+	});
+}
+
+void ReinhardToneOperator::apply(const Vector3* in, uint32_t* out, int count) const
+{
+	tonemap(in, out, count, [](simd_f32 c)
+	{
+		c = simd_max(c, simd_set(0.f));
+		return simd_sqrt(simd_div(c, simd_add(c, simd_set(1.f))));
+	});
+}
+
+void AcesToneOperator::apply(const Vector3* in, uint32_t* out, int count) const
+{
+	tonemap(in, out, count, [](simd_f32 c)
+	{
+		c = simd_max(c, simd_set(0.f));
+		const simd_f32 mapped = simd_div(simd_mul(c, simd_add(simd_mul(simd_set(2.51f), c), simd_set(0.03f))),
+		                                 simd_add(simd_mul(c, simd_add(simd_mul(simd_set(2.43f), c), simd_set(0.59f))),
+		                                          simd_set(0.14f)));
+		return simd_sqrt(simd_min(mapped, simd_set(1.f)));
+	});
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include "Vector3.h"
+
+/**
+ * Maps the high dynamic range colors the tracer accumulates to the packed 8 bit RGBA the
+ * window displays. Runs over whole rows at a time just before a frame is presented, so the
+ * curve and gamma are applied to SIMD_LANES pixels at once and only to frames that are shown.
+ */
+class ToneOperator
+{
+public:
+	virtual ~ToneOperator() = default;
+
+	//Tonemaps, gamma corrects and packs count colors into out as RGBA8888 with full alpha
+	virtual void apply(const Vector3* in, uint32_t* out, int count) const = 0;
+};
+
+//Hejl and Burgess-Dawson filmic curve, gamma is baked into the fit
+//https://www.slideshare.net/ozlael/hable-john-uncharted2-hdr-lighting  slide 140
+class FilmicToneOperator : public ToneOperator
+{
+public:
+	void apply(const Vector3* in, uint32_t* out, int count) const override;
+};
+
+//Reinhard's c / (1 + c) followed by gamma 2
+class ReinhardToneOperator : public ToneOperator
+{
+public:
+	void apply(const Vector3* in, uint32_t* out, int count) const override;
+};
+
+//Narkowicz's fit of the ACES reference curve followed by gamma 2
+class AcesToneOperator : public ToneOperator
+{
+public:
+	void apply(const Vector3* in, uint32_t* out, int count) const override;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+
+/**
+ * Hands values from one thread to another without either ever waiting on the other.
+ * The writer fills its own buffer and swaps it with the shared middle one, the reader
+ * swaps its own buffer with the middle one when something new has been published there.
+ * Values the reader does not get to before the next publish are dropped.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	explicit TripleBuffer(const T& initial) : buffers{initial, initial, initial}
+	{
+	}
+
+	//Buffer only the writer touches until it publishes it
+	T& getWriteBuffer() { return buffers[back]; }
+
+	//Makes the write buffer the newest value and takes over an old one to write the next into
+	void publish()
+	{
+		back = middle.exchange(back | FRESH) & INDEX;
+	}
+
+	//Whether the last published value has not been picked up by the reader yet
+	bool isPending() const
+	{
+		return (middle.load() & FRESH) != 0;
+	}
+
+	//Switches the read buffer to the newest published value, false if nothing new was published
+	bool update()
+	{
+		if (!isPending())
+			return false;
+		front = middle.exchange(front) & INDEX;
+		return true;
+	}
+
+	//Buffer only the reader touches until its next update
+	const T& getReadBuffer() const { return buffers[front]; }
+
+private:
+	static const int INDEX = 3;
+	//Set on the middle index while it holds a value the reader has not taken
+	static const int FRESH = 4;
+
+	T buffers[3];
+	int back = 0;
+	std::atomic<int> middle{1};
+	int front = 2;
+};
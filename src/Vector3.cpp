@@ -137,6 +137,11 @@ int Vector3::getLargestComponentIndex() const
 	return 0;
 }
 
+float Vector3::getMaxComponent() const
+{
+	return x > y ? (x > z ? x : z) : (y > z ? y : z);
+}
+
 void Vector3::transformQuat(const Quat& q)
 {
 	Vector3 qvec = Vector3(q.x,q.y,q.z);
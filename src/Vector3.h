@@ -53,6 +53,7 @@ public:
 	float distance(const Vector3& v) const;
 	float distanceSquared(const Vector3& v) const;
 	int getLargestComponentIndex()const;
+	float getMaxComponent() const;
 
 	void transformQuat(const Quat& quat);
 
@@ -0,0 +1,137 @@
+#include "WavefrontTracer.h"
+#include "Scene.h"
+#include "Metal.h"
+#include "Globals.h"
+#include "Random.h"
+#include "PathGuide.h"
+#include <cfloat>
+
+void WavefrontTracer::begin(int count)
+{
+	if (count > paths.size)
+	{
+		hits.resize(count);
+		for (auto& bin : bins)
+			bin.reserve(count);
+		active.reserve(count);
+	}
+	paths.resize(count);
+	cached_hit.resize(count);
+}
+
+void WavefrontTracer::trace(const Scene& scene)
+{
+	active.clear();
+	for (int i = 0; i < paths.size; i++)
+		if (paths.alive[i])
+			active.push_back(i);
+
+	while (!active.empty())
+	{
+		intersect(scene);
+		recordGuides();
+		shade(scene);
+		terminate();
+	}
+
+	if (g_path_guide)
+		g_path_guide->record(paths);
+}
+
+void WavefrontTracer::intersect(const Scene& scene)
+{
+	for (auto& bin : bins)
+		bin.clear();
+
+	HitRecord rec;
+	for (const int i : active)
+	{
+		if (cached_hit[i])
+		{
+			cached_hit[i] = 0;
+			bins[int(hits.material[i]->type)].push_back(i);
+		}
+		else if (scene.hit(paths.getRay(i), 0.001f, FLT_MAX, rec))
+		{
+			hits.set(i, rec);
+			if (!paths.guide_found[i])
+				paths.guide_depth[i] += rec.t * paths.getRay(i).direction.length();
+			bins[int(rec.mat_ptr->type)].push_back(i);
+		}
+		else
+		{
+			paths.addRadiance(i, AMBIENT_LIGHT);
+			paths.alive[i] = 0;
+		}
+	}
+}
+
+//Paths that have not found their guide surface yet take the one they just hit unless it is specular
+void WavefrontTracer::recordGuides()
+{
+	for (const auto& bin : bins)
+	{
+		for (const int i : bin)
+		{
+			if (paths.guide_found[i] || hits.material[i]->isSpecular())
+				continue;
+			paths.setGuides(i, hits.material[i]->getAlbedo(hits.get(i)), hits.getNormal(i), hits.primitive[i]);
+		}
+	}
+}
+
+void WavefrontTracer::shade(const Scene& scene)
+{
+	auto& lambertian = bins[int(MaterialType::Lambertian)];
+	auto& metal = bins[int(MaterialType::Metal)];
+	auto& dialectric = bins[int(MaterialType::Dialectric)];
+	auto& diffuse_light = bins[int(MaterialType::DiffuseLight)];
+	auto& generic = bins[int(MaterialType::Generic)];
+
+	Lambertian::scatterBatch(paths, hits, scene, lambertian.data(), int(lambertian.size()));
+	Metal::scatterBatch(paths, hits, metal.data(), int(metal.size()));
+	Dialectric::scatterBatch(paths, hits, dialectric.data(), int(dialectric.size()));
+	DiffuseLight::shadeBatch(paths, hits, scene, diffuse_light.data(), int(diffuse_light.size()));
+	Material::shadeGenericBatch(paths, hits, generic.data(), int(generic.size()));
+}
+
+//Drops absorbed paths from the active list and applies depth limit and Russian roulette to the rest
+void WavefrontTracer::terminate()
+{
+	int live = 0;
+	for (const int i : active)
+	{
+		if (!paths.alive[i])
+			continue;
+
+		if (paths.depth[i] >= MAX_RAY_DEPTH)
+		{
+			paths.alive[i] = 0;
+			continue;
+		}
+
+		//Nothing this path gathers from here on would be visible
+		const float max_throughput = paths.getThroughput(i).getMaxComponent();
+		if (max_throughput < MIN_THROUGHPUT)
+		{
+			paths.alive[i] = 0;
+			continue;
+		}
+
+		//Russian roulette, survivors are reweighted so the estimate stays unbiased
+		if (paths.depth[i] >= RUSSIAN_ROULETTE_DEPTH)
+		{
+			const float survive_prob = max_throughput < 0.95f ? max_throughput : 0.95f;
+			if (paths.getSample(i, Sampler::Roulette) >= survive_prob)
+			{
+				paths.alive[i] = 0;
+				continue;
+			}
+			paths.attenuate(i, Vector3(1.0f / survive_prob));
+		}
+
+		paths.depth[i]++;
+		active[live++] = i;
+	}
+	active.resize(live);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include "ShadingBatch.h"
+#include "Material.h"
+
+class Scene;
+
+/**
+ * Traces a wavefront of camera paths together. Every bounce intersects all
+ * live paths first, then bins the hits by material type and runs one batch
+ * kernel per bin, so each kernel works through a homogeneous set of hits
+ * instead of dispatching virtually per hit.
+ */
+class WavefrontTracer
+{
+public:
+	PathBatch paths;
+	HitBatch hits;
+
+	//Prepares count path slots, each must be given a sample key and then started
+	void begin(int count);
+
+	//Pixel and sample index the path in slot i draws its sample values for
+	void setSampleKey(int i, int pixel, unsigned int sample, int first_dimension = Sampler::CameraDimensions)
+	{
+		paths.pixel[i] = pixel;
+		paths.sample[i] = sample;
+		paths.first_dimension[i] = first_dimension;
+	}
+
+	void setCameraRay(int i, const Ray& ray)
+	{
+		paths.start(i, ray);
+		cached_hit[i] = 0;
+	}
+
+	//Starts a path at a vertex found earlier, ray is the ray that arrived there and distance the length
+	//of the path up to the vertex. The first bounce skips intersection and shades hit directly.
+	void startAtVertex(int i, const Ray& ray, const HitRecord& hit, const Vector3& throughput, int depth,
+	                   float distance)
+	{
+		paths.start(i, ray);
+		paths.attenuate(i, throughput);
+		paths.depth[i] = depth;
+		paths.guide_depth[i] = distance;
+		hits.set(i, hit);
+		cached_hit[i] = 1;
+	}
+
+	//Starts a path that is already complete with the given radiance
+	void startFinished(int i, const Vector3& radiance)
+	{
+		paths.start(i, Ray());
+		paths.addRadiance(i, radiance);
+		paths.alive[i] = 0;
+		cached_hit[i] = 0;
+	}
+
+	//Traces every path until it is absorbed, escapes or is terminated
+	void trace(const Scene& scene);
+
+	Vector3 getRadiance(int i) const
+	{
+		return paths.getRadiance(i);
+	}
+
+	//Guide buffer values of path i, zero when it found no surface that is not specular
+	Vector3 getAlbedo(int i) const
+	{
+		return paths.getGuideAlbedo(i);
+	}
+
+	Vector3 getNormal(int i) const
+	{
+		return paths.getGuideNormal(i);
+	}
+
+	float getDepth(int i) const
+	{
+		return paths.guide_found[i] ? paths.guide_depth[i] : 0.f;
+	}
+
+	//-1 when it found no surface that is not specular
+	int getId(int i) const
+	{
+		return paths.guide_id[i];
+	}
+
+private:
+	std::vector<int> active;
+	//Paths whose next hit is already in hits
+	std::vector<unsigned char> cached_hit;
+	std::vector<int> bins[int(MaterialType::Count)];
+
+	void intersect(const Scene& scene);
+	void recordGuides();
+	void shade(const Scene& scene);
+	void terminate();
+};
@@ -2,6 +2,35 @@
 #include "Hitable.h"
 #include "Material.h"
 
+/**
+ * Intersection with an axis aligned rectangle on the plane where axis A equals rect.k.
+ * B and C are the other two axes in x, y, z order and give the extents and texture coords.
+ */
+template <int A, int B, int C>
+bool intersectRect(const RectData& rect, const Ray& ray, float t_min, float t_max, HitRecord& hit_record)
+{
+	float t = (rect.k - ray.origin[A]) / ray.direction[A];
+
+	if (t < t_min || t > t_max)
+		return false;
+
+	float b = ray.origin[B] + t * ray.direction[B];
+	float c = ray.origin[C] + t * ray.direction[C];
+
+	if (b < rect.b0 || b > rect.b1 || c < rect.c0 || c > rect.c1)
+		return false;
+
+	HitRecord temp_rec;
+	temp_rec.u = (b - rect.b0) / (rect.b1 - rect.b0);
+	temp_rec.v = (c - rect.c0) / (rect.c1 - rect.c0);
+	temp_rec.t = t;
+	temp_rec.mat_ptr = rect.mat_ptr;
+	temp_rec.position = ray.point_at_parameter(t);
+	temp_rec.normal = Vector3::ZERO;
+	temp_rec.normal[A] = rect.flip_normals ? -1.f : 1.f;
+	hit_record = temp_rec;
+	return true;
+}
 
 class XYRect : public Hitable
 {
@@ -27,27 +56,14 @@ public:
 
 	bool hit(const Ray& r, float t_min, float t_max, HitRecord& hit_record) const override
 	{
-		Ray ray = r;
-		float t = (k - ray.origin.z) / ray.direction.z;
-
-		if (t < t_min || t > t_max)
-			return false;
-
-		float x = ray.origin.x + t * ray.direction.x;
-		float y = ray.origin.y + t * ray.direction.y;
-
-		if (x < x0 || x > x1 || y < y0 || y > y1)
-			return false;
-
-		HitRecord temp_rec;
-		temp_rec.u = (x - x0) / (x1 - x0);
-		temp_rec.v = (y - y0) / (y1 - y0);
-		temp_rec.t = t;
-		temp_rec.mat_ptr = mp;
-		temp_rec.position = ray.point_at_parameter(t);
-		temp_rec.normal = flip_normals ? Vector3::UNIT_Z_NEG : Vector3::UNIT_Z_POS;
-		hit_record = temp_rec;
-		return true;
+		return intersectRect<2, 0, 1>(RectData{x0, x1, y0, y1, k, mp, flip_normals}, r, t_min, t_max, hit_record);
+	}
+
+	void flatten(PrimitiveStore& store) const override
+	{
+		AABB box;
+		bounding_box(store.time0, store.time1, box);
+		store.add(PrimitiveType::XYRect, RectData{x0, x1, y0, y1, k, mp, flip_normals}, box);
 	}
 
 	bool bounding_box(float t0, float t1, AABB& b) const override
@@ -87,29 +103,14 @@ public:
 
 	bool hit(const Ray& r, float t_min, float t_max, HitRecord& hit_record) const override
 	{
-		Ray ray = r;
-		HitRecord temp_rec;
-		float t = (k - ray.origin.y) / ray.direction.y;
-
-		if (t < t_min || t > t_max)
-			return false;
-
-		float x = ray.origin.x + t * ray.direction.x;
-		float z = ray.origin.z + t * ray.direction.z;
-
-		if (x < x0 || x > x1 || z < z0 || z > z1)
-			return false;
-
-
-		temp_rec.u = (x - x0) / (x1 - x0);
-		temp_rec.v = (z - z0) / (z1 - z0);
-		temp_rec.t = t;
-		temp_rec.mat_ptr = mp;
-		temp_rec.position = ray.point_at_parameter(t);
-		temp_rec.normal = flip_normals ? Vector3::UNIT_Y_NEG : Vector3::UNIT_Y_POS;
+		return intersectRect<1, 0, 2>(RectData{x0, x1, z0, z1, k, mp, flip_normals}, r, t_min, t_max, hit_record);
+	}
 
-		hit_record = temp_rec;
-		return true;
+	void flatten(PrimitiveStore& store) const override
+	{
+		AABB box;
+		bounding_box(store.time0, store.time1, box);
+		store.add(PrimitiveType::XZRect, RectData{x0, x1, z0, z1, k, mp, flip_normals}, box);
 	}
 };
 
@@ -144,26 +145,13 @@ public:
 
 	bool hit(const Ray& r, float t_min, float t_max, HitRecord& hit_record) const override
 	{
-		Ray ray = r;
-		float t = (k - ray.origin.x) / ray.direction.x;
-
-		if (t < t_min || t > t_max)
-			return false;
-
-		float y = ray.origin.y + t * ray.direction.y;
-		float z = ray.origin.z + t * ray.direction.z;
-
-		if (y < y0 || y > y1 || z < z0 || z > z1)
-			return false;
-
-		HitRecord temp_rec;
-		temp_rec.u = (y - y0) / (y1 - y0);
-		temp_rec.v = (z - z0) / (z1 - z0);
-		temp_rec.t = t;
-		temp_rec.mat_ptr = mp;
-		temp_rec.position = ray.point_at_parameter(t);
-		temp_rec.normal = flip_normals ? Vector3::UNIT_X_NEG : Vector3::UNIT_X_POS;
-		hit_record = temp_rec;
-		return true;
+		return intersectRect<0, 1, 2>(RectData{y0, y1, z0, z1, k, mp, flip_normals}, r, t_min, t_max, hit_record);
+	}
+
+	void flatten(PrimitiveStore& store) const override
+	{
+		AABB box;
+		bounding_box(store.time0, store.time1, box);
+		store.add(PrimitiveType::YZRect, RectData{y0, y1, z0, z1, k, mp, flip_normals}, box);
 	}
 };
@@ -13,6 +13,8 @@
 
 
 #include <iostream>
+#include <thread>
+#include <atomic>
 #include "SDL2/SDL.h"
 #include "Random.h"
 #include "Sphere.h"
@@ -26,13 +28,28 @@
 #include "Metal.h"
 #include "BlinnPhong.h"
 #include "Globals.h"
+#include "WavefrontTracer.h"
+#include "Scene.h"
+#include "PrimaryCache.h"
+#include "Sampler.h"
+#include "SampleScheduler.h"
+#include "PathGuide.h"
+#include "LightTracer.h"
+#include "PhotonMapper.h"
+#include "TileRenderer.h"
+#include "Tonemap.h"
+#include "TripleBuffer.h"
+#include "TemporalReprojection.h"
+#include "ProgressiveRefinement.h"
+#include "AccumulationBuffer.h"
+#include "AovBuffer.h"
+#include "Denoiser.h"
 
 using std::cout;
 using std::endl;
 
 Vector3 uint32_to_vector3(Uint32 color);
-Uint32 vector3_to_uint32(const Vector3& color, float alpha = 1);
-Vector3 ray_trace(const Ray& ray, Hitable* world, int depth);
+Ray jittered_camera_ray(int x, int y, unsigned int sample);
 
 Hitable* cornell_box();
 
@@ -41,6 +58,8 @@ void setupCornellWalls(Hitable** list, int& i);
 Vector3 eye(278, 278, 1);
 Vector3 target(278, 278, 0);
 const float vFOV = 40;
+//Distance the camera moves for every millisecond a key is held
+const float CAMERA_SPEED = 0.5f;
 
 int main(int argc, char** argv)
 {
@@ -52,89 +71,298 @@ int main(int argc, char** argv)
 	SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, SCREEN_WIDTH,
 	                                         SCREEN_HEIGHT);
 
-	//RGB 32bit float data to allow for precise sampling and blending of colors
-	Vector3* float_pixels = new Vector3[SCREEN_WIDTH * SCREEN_HEIGHT];
-	memset(float_pixels, 0, sizeof(Vector3) * SCREEN_WIDTH * SCREEN_HEIGHT);
-
-	//RGBA 8 bit color for displaying
-	Uint32* pixels = new Uint32[SCREEN_WIDTH * SCREEN_HEIGHT];
-	memset(pixels, 0, sizeof(Uint32) * SCREEN_WIDTH * SCREEN_HEIGHT);
+	//Sums of the samples of every pixel in high dynamic range, the means are formed for displaying
+	AccumulationBuffer accumulation;
+	accumulation.resize(SCREEN_WIDTH * SCREEN_HEIGHT);
 
 	SDL_SetRenderDrawColor(renderer, 50, 100, 50, 255);
 	SDL_RenderClear(renderer);
 
 	//Setup Camera and world
 	camera = Camera(eye, target, {0, 1, 0}, vFOV, ASPECT_RATIO, 0, (eye - target).length() * 2, 0, 1);
-	world = cornell_box();
+	//The authored hierarchy is committed once into the flat form the tracer uses
+	Scene* scene = new Scene();
+	scene->commit(cornell_box(), camera.time0, camera.time1);
+	world = scene;
+	//Emitters in the scene double as the lights of materials that shade against g_lights
+	g_lights.clear();
+	scene->appendLights(g_lights);
+	g_light_tree.build(g_lights);
+	AABB scene_bounds;
+	scene->bounding_box(camera.time0, camera.time1, scene_bounds);
+#ifdef PATH_GUIDING
+	g_path_guide = new PathGuide(scene_bounds, PATH_GUIDE_MEMORY);
+#endif
+#ifdef LIGHT_TRACING
+	g_light_tracer = new LightTracer();
+	g_light_tracer->resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+#endif
+#ifdef PHOTON_MAPPING
+	g_photon_mapper = new PhotonMapper();
+	g_photon_mapper->resize(SCREEN_WIDTH, SCREEN_HEIGHT, (scene_bounds.max - scene_bounds.min).length());
+#endif
 
-	//Timer for delta time
-	PerformanceCounter time{};
-	time.start();
+	//Means of accumulation as displayed, with the caustics of g_light_tracer or g_photon_mapper added
+	//and the pixels a partial pass of refinement skipped filled in
+	Vector3* display_pixels = new Vector3[SCREEN_WIDTH * SCREEN_HEIGHT];
 
-	//number of samples completed
-	int samples = 0;
-	unsigned long int seed = 1;
-	//Render loop
-	bool quit = false;
-	while (!quit)
-	{
-		//Blend factor for each sample
-		const double blend_factor = 1.0 / double(samples + 1);
+#ifdef PRIMARY_CACHE
+	PrimaryCache primary_cache;
+	primary_cache.resize(SCREEN_WIDTH * SCREEN_HEIGHT);
+#endif
 
-		//Parallelize the loop for each row of pixels
-		seed = Random::rand31pm_next(&seed);
+	SampleScheduler scheduler;
+	scheduler.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
 
-#pragma omp parallel for
-		for (int y = 0; y < SCREEN_HEIGHT; y++)
-		{
-			//Thread safe random generator
-			//thread_local std::mt19937 gen(std::random_device{}());
-			thread_local long unsigned int seedp = seed;
-			for (int x = 0; x < SCREEN_WIDTH; x++)
-			{
-				const float fx = float(x), fy = float(y);
+#ifdef TEMPORAL_REPROJECTION
+	TemporalReprojection reprojection;
+	reprojection.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+	reprojection.setView(camera, world);
+#endif
 
-				//Jiggle the pixel
-				float u = Random::randf( fx, fx + 1);
-				float v = Random::randf( fy, fy + 1);
+	//Albedo, normal, depth and so on of what each pixel shows, accumulated next to accumulation,
+	//only the channels some stage reads are kept
+	int aov_channels = 0;
+#ifdef DENOISING
+	aov_channels |= AovBuffer::Albedo | AovBuffer::Normal | AovBuffer::Depth;
+#endif
+#ifdef AOV_DEBUG_VIEWS
+	aov_channels = AovBuffer::AllChannels;
+	//Channel shown instead of the image, 0 for the image
+	std::atomic<int> debug_view{0};
+#endif
+	AovBuffer aovs;
+	aovs.resize(SCREEN_WIDTH, SCREEN_HEIGHT, aov_channels);
+#ifdef DENOISING
+	Denoiser denoiser;
+	denoiser.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+#endif
 
-				//Get the pixel in 0 to 1 space
-				u = u / float(SCREEN_WIDTH);
-				v = v / float(SCREEN_HEIGHT);
+	TileRenderer tile_renderer;
+	tile_renderer.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
 
-				Ray ray = camera.getRay(u, v);
+#ifdef DYNAMIC_RESOLUTION
+	ProgressiveRefinement refinement(FRAME_TIME_BUDGET);
+#else
+	ProgressiveRefinement refinement;
+#endif
 
-				//Ray trace and get the color of the pixel
-				Vector3 color = ray_trace(ray, world, 0);
+	//Finished frames go to the display through a triple buffer and camera changes come back through
+	//another, so neither thread ever waits for the other
+	TripleBuffer<std::vector<Uint32>> frames(std::vector<Uint32>(SCREEN_WIDTH * SCREEN_HEIGHT, 0));
+	TripleBuffer<Camera> camera_updates(camera);
+	std::atomic<bool> quit{false};
+#ifdef FOVEATED_SAMPLING
+	//Whether samples go to the region around the cursor, and where the cursor is
+	std::atomic<bool> foveated{false};
+	std::atomic<int> focus_x{SCREEN_WIDTH / 2}, focus_y{SCREEN_HEIGHT / 2};
+#endif
+
+	//Tracing runs on its own thread so presenting and input handling never stall the tracers,
+	//and input is handled at display rate instead of once per rendered frame
+	std::thread render_thread([&]()
+	{
+		//Timer for frame time
+		PerformanceCounter time{};
+		time.start();
+
+		//number of frames completed
+		int samples = 0;
+		while (!quit)
+		{
+			//Measures the whole frame from reprojection to publishing, it decides the resolution of the next ones
+			PerformanceCounter frame_time{};
+			frame_time.start();
+
+			//If camera moved reset the pixel data
+			if (camera_updates.update())
+			{
+				camera = camera_updates.getReadBuffer();
+#ifdef PROGRESSIVE_REFINEMENT
+				refinement.restart();
+#endif
+#ifdef TEMPORAL_REPROJECTION
+				//Surfaces still in view keep their samples, only the rest starts over.
+				//Only the grid the frame samples is traced, so the coarse frame is not held up.
+				reprojection.reproject(camera, world, refinement.getStride(), accumulation, scheduler);
+				aovs.reproject(reprojection.getSource(), reprojection.getDistance(), scheduler);
+#else
+				accumulation.reset();
+				scheduler.reset();
+				aovs.reset();
+#endif
+				if (g_light_tracer)
+					g_light_tracer->reset();
+				if (g_photon_mapper)
+					g_photon_mapper->reset();
+				samples = 0;
+#ifdef PRIMARY_CACHE
+				primary_cache.invalidate();
+#endif
+			}
+
+			//One sample per pixel worth of work, spent where the image is noisiest
+			//Right after a move only a sparse grid of pixels is sampled
+			const int stride = refinement.getStride();
+#ifdef FOVEATED_SAMPLING
+			if (foveated)
+				scheduler.setFocus(focus_x, focus_y, focus_x + 1, focus_y + 1, FOCUS_RADIUS);
+			else
+				scheduler.clearFocus();
+#endif
+			const int scheduled = scheduler.schedule(accumulation, SCREEN_WIDTH * SCREEN_HEIGHT / (stride * stride), stride);
 
-				//Color is stored in high dynamic range
-				//Blend the new color with the old color using blend factor
-				float_pixels[(SCREEN_HEIGHT - y - 1) * SCREEN_WIDTH + x].mix(color, float(blend_factor));
+			//Caustics come from the lights, they are splatted first so the rows below display them
+			if (g_light_tracer)
+				g_light_tracer->trace(*scene, camera, LightTracer::PATHS_PER_FRAME);
+			if (g_photon_mapper)
+				g_photon_mapper->trace(*scene, camera);
 
-				//HDR + Gamma Correction Magic
-				//https://www.slideshare.net/ozlael/hable-john-uncharted2-hdr-lighting  slide 140
-				color = float_pixels[(SCREEN_HEIGHT - y - 1) * SCREEN_WIDTH + x];
-				color -= 0.004f;
-				color.clampMin(0);
-				color = (color * (6.2f * color + 0.5f)) / (color * (6.2f * color + 1.7f) + 0.06f);
+			//Tiles are handed out dynamically, those crossing the glass sphere take far longer than flat walls.
+			//Every random draw is keyed by pixel and sample, so the image does not depend on the thread count.
+			tile_renderer.render([&](const TileRenderer::Tile& tile)
+			{
+				int tile_samples = 0;
+				for (int row = tile.y0; row < tile.y1; row++)
+					for (int x = tile.x0; x < tile.x1; x++)
+						tile_samples += scheduler.getScheduled(row * SCREEN_WIDTH + x);
+				if (tile_samples == 0)
+					return;
+
+				//Each thread traces its tiles as one wavefront of paths
+				thread_local WavefrontTracer tracer;
+				tracer.begin(tile_samples);
+
+				int slot = 0;
+				for (int row = tile.y0; row < tile.y1; row++)
+				{
+					const int y = SCREEN_HEIGHT - row - 1;
+					for (int x = tile.x0; x < tile.x1; x++)
+					{
+						const int pixel = row * SCREEN_WIDTH + x;
+						const int first_sample = scheduler.getSampleCount(pixel);
+						for (int s = first_sample; s < first_sample + scheduler.getScheduled(pixel); s++, slot++)
+						{
+#ifdef PRIMARY_CACHE
+							//Samples cycle through the cached jitter positions of the pixel
+							tracer.setSampleKey(slot, pixel, PrimaryCache::pathSample(s), PrimaryCache::pathFirstDimension(s));
+							PrimaryCache::Entry& entry = primary_cache.get(pixel, s);
+							if (!primary_cache.isFilled(entry, s))
+							{
+								const unsigned int jitter = PrimaryCache::jitterSample(s);
+								primary_cache.fill(entry, jittered_camera_ray(x, y, jitter), jitter, world);
+							}
+
+							if (entry.has_vertex)
+								tracer.startAtVertex(slot, entry.ray, entry.hit, entry.throughput, entry.depth, entry.distance);
+							else
+								tracer.startFinished(slot, entry.radiance);
+#else
+							tracer.setSampleKey(slot, pixel, s);
+							tracer.setCameraRay(slot, jittered_camera_ray(x, y, s));
+#endif
+						}
+					}
+				}
+
+				//Ray trace and get the color of the pixels
+				tracer.trace(*scene);
+
+				slot = 0;
+				for (int row = tile.y0; row < tile.y1; row++)
+				{
+					for (int x = tile.x0; x < tile.x1; x++)
+					{
+						const int pixel = row * SCREEN_WIDTH + x;
+						const int pixel_samples = scheduler.getScheduled(pixel);
+						if (pixel_samples == 0)
+							continue;
+
+						//Color is summed in high dynamic range, the count is kept by the scheduler
+						for (int s = 0; s < pixel_samples; s++, slot++)
+						{
+							scheduler.accumulate(accumulation, pixel, tracer.getRadiance(slot));
+							aovs.accumulate(x, row, scheduler.getSampleCount(pixel), tracer.getAlbedo(slot), tracer.getNormal(slot),
+							                tracer.getDepth(slot), tracer.getId(slot));
+						}
+					}
+				}
+			});
+			samples++;
+			if (g_path_guide)
+				g_path_guide->endFrame();
+			cout << "Sample " << samples << " (" << scheduled << " paths)" << endl;
+			tile_renderer.printStats(cout);
+			cout << "time: " << time.getAndReset();
+
+			//A frame the display has not picked up yet is left for it rather than replaced,
+			//so only frames that get presented are tonemapped. Such a frame skipped the display
+			//stages, its time says nothing about the cost of a presented one.
+			if (frames.isPending())
+			{
+				refinement.advance(0.0);
+				continue;
+			}
 
-				//Output color is corrected
-				pixels[(SCREEN_HEIGHT - y - 1) * SCREEN_WIDTH + x] = vector3_to_uint32(color);
+			//Tonemapped from high dynamic range into 8 bit RGBA for displaying
+			Uint32* pixels = frames.getWriteBuffer().data();
+#pragma omp parallel for
+			for (int pixel = 0; pixel < SCREEN_WIDTH * SCREEN_HEIGHT; pixel++)
+			{
+				display_pixels[pixel] = accumulation.getMean(pixel, scheduler.getSampleCount(pixel));
+				if (g_light_tracer)
+					display_pixels[pixel] += g_light_tracer->getRadiance(pixel);
+				if (g_photon_mapper)
+					display_pixels[pixel] += g_photon_mapper->getRadiance(pixel);
 			}
+			if (stride > 1)
+				refinement.fill(display_pixels, scheduler, stride, SCREEN_WIDTH, SCREEN_HEIGHT);
+#ifdef DENOISING
+			denoiser.denoise(display_pixels, aovs, scheduler, display_pixels);
+#endif
+#ifdef AOV_DEBUG_VIEWS
+			if (debug_view != 0)
+				aovs.visualize(AovBuffer::Channel(debug_view.load()), display_pixels);
+#endif
+#pragma omp parallel for
+			for (int row = 0; row < SCREEN_HEIGHT; row++)
+				g_tone_operator->apply(display_pixels + row * SCREEN_WIDTH, pixels + row * SCREEN_WIDTH, SCREEN_WIDTH);
+			frames.publish();
+			refinement.advance(frame_time.getCounter());
 		}
-		samples++;
-		cout << "Sample " << samples << endl;
-		cout << "time: " << time.getAndReset();
+	});
+
+	//The display thread owns the window and input, it steers its own copy of the camera
+	Camera view = camera;
 
-		//Ouput to screen
-		SDL_UpdateTexture(texture, NULL, pixels, sizeof(Uint32) * SCREEN_WIDTH);
-		SDL_RenderCopy(renderer, texture,NULL,NULL);
-		SDL_RenderPresent(renderer);
+	//Timer for delta time
+	PerformanceCounter time{};
+	time.start();
+
+	//Whether the window has to be drawn again even without a new frame
+	bool redraw = true;
+
+	//Display loop
+	while (!quit)
+	{
+		//Ouput to screen only when the render thread finished a frame or the window was uncovered,
+		//otherwise the loop just polls input
+		if (frames.update())
+		{
+			SDL_UpdateTexture(texture, NULL, frames.getReadBuffer().data(), sizeof(Uint32) * SCREEN_WIDTH);
+			redraw = true;
+		}
+		if (redraw)
+		{
+			SDL_RenderCopy(renderer, texture,NULL,NULL);
+			SDL_RenderPresent(renderer);
+			redraw = false;
+		}
 
 
 		//Input/Event Update -------------------
 		int last_x = mouse_x, last_y = mouse_y;
-		float delta_time = float(time.getAndReset() / 2.0);
+		float delta_time = float(time.getAndReset()) * CAMERA_SPEED;
 		bool moved = false;
 
 		SDL_Event event;
@@ -145,10 +373,18 @@ int main(int argc, char** argv)
 			case SDL_QUIT:
 				quit = true;
 				break;
+			case SDL_WINDOWEVENT:
+				if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+					redraw = true;
+				break;
 			case SDL_MOUSEMOTION:
+#ifdef FOVEATED_SAMPLING
+				focus_x = event.motion.x;
+				focus_y = event.motion.y;
+#endif
 				if (!mouse_down) break;
 				SDL_GetMouseState(&mouse_x, &mouse_y);
-				camera.processMouseMovement(mouse_x - last_x, mouse_y - last_y);
+				view.processMouseMovement(mouse_x - last_x, mouse_y - last_y);
 				last_x = mouse_x, last_y = mouse_y;
 				moved = true;
 				break;
@@ -160,6 +396,20 @@ int main(int argc, char** argv)
 			case SDL_MOUSEBUTTONUP:
 				mouse_down = false;
 				break;
+			case SDL_KEYDOWN:
+				if (event.key.repeat)
+					break;
+#ifdef AOV_DEBUG_VIEWS
+				//V cycles the display through the image and every AOV channel
+				if (event.key.keysym.scancode == SDL_SCANCODE_V)
+					debug_view = debug_view == 0 ? AovBuffer::Albedo : debug_view == AovBuffer::SampleCount ? 0 : debug_view * 2;
+#endif
+#ifdef FOVEATED_SAMPLING
+				//F toggles spending the samples around the cursor
+				if (event.key.keysym.scancode == SDL_SCANCODE_F)
+					foveated = !foveated;
+#endif
+				break;
 			}
 		}
 
@@ -167,44 +417,47 @@ int main(int argc, char** argv)
 		if (state[SDL_SCANCODE_R])
 		{
 			moved = true;
-			camera.position = eye;
-			camera.lookAt(target);
+			view.position = eye;
+			view.lookAt(target);
 		}
 		if (state[SDL_SCANCODE_A])
 		{
-			camera.moveRight(-delta_time);
+			view.moveRight(-delta_time);
 			moved = true;
 		}
 
 		if (state[SDL_SCANCODE_D])
 		{
 			moved = true;
-			camera.moveRight(delta_time);
+			view.moveRight(delta_time);
 		}
 		if (state[SDL_SCANCODE_W])
 		{
-			camera.moveForward(-delta_time);
+			view.moveForward(-delta_time);
 			moved = true;
 		}
 
 		if (state[SDL_SCANCODE_S])
 		{
 			moved = true;
-			camera.moveForward(delta_time);
+			view.moveForward(delta_time);
 		}
 		if (state[SDL_SCANCODE_SPACE])
 		{
 			moved = true;
-			camera.moveUp(delta_time);
+			view.moveUp(delta_time);
 		}
 
-		//If camera moved reset the pixel data
 		if (moved)
 		{
-			memset(float_pixels, 0, sizeof(Vector3) * SCREEN_WIDTH * SCREEN_HEIGHT);
-			samples = 0;
+			camera_updates.getWriteBuffer() = view;
+			camera_updates.publish();
 		}
+
+		//Input is polled about once a millisecond, the rest of the core is left to the tracers
+		SDL_Delay(1);
 	}
+	render_thread.join();
 
 	SDL_DestroyWindow(window);
 	SDL_Quit();
@@ -213,19 +466,21 @@ int main(int argc, char** argv)
 }
 
 
-//Converts a rgb float Vector color to Uint32 rgba 8 bit color
-Uint32 vector3_to_uint32(const Vector3& color, float alpha)
+//Camera ray for a sample of pixel x, y, jitter, lens and time are drawn from g_sampler
+Ray jittered_camera_ray(int x, int y, unsigned int sample)
 {
-	int r = int(255.9 * color.r);
-	r = std::clamp(r, 0, 255);
-	int g = int(255.9 * color.g);
-	g = std::clamp(g, 0, 255);
-	int b = int(255.9 * color.b);
-	b = std::clamp(b, 0, 255);
-	int a = int(255.9 * alpha);
-	a = std::clamp(a, 0, 255);
-	auto result = r << 24 | g << 16 | b << 8 | a;
-	return result;
+	const int pixel = (SCREEN_HEIGHT - y - 1) * SCREEN_WIDTH + x;
+
+	//Jiggle the pixel
+	float u = float(x) + g_sampler->get(pixel, sample, Sampler::PixelX);
+	float v = float(y) + g_sampler->get(pixel, sample, Sampler::PixelY);
+
+	//Get the pixel in 0 to 1 space
+	u = u / float(SCREEN_WIDTH);
+	v = v / float(SCREEN_HEIGHT);
+
+	return camera.getRay(u, v, g_sampler->get(pixel, sample, Sampler::LensU),
+	                     g_sampler->get(pixel, sample, Sampler::LensV), g_sampler->get(pixel, sample, Sampler::Time));
 }
 
 //Converts Uint32 rgba 8 bit color to a rgb float Vector color
@@ -236,28 +491,6 @@ Vector3 uint32_to_vector3(Uint32 color)
 	return rgb;
 }
 
-Vector3 ray_trace(const Ray& ray, Hitable* world, int depth)
-{
-	HitRecord rec;
-	Ray ray_out;
-	ray_out.time = ray.time;
-	Vector3 attenuation;
-
-	if (world->hit(ray, 0.001f, FLT_MAX, rec))
-	{
-		Vector3 emitted = rec.mat_ptr->emitted(ray, rec);
-		if (depth < MAX_RAY_DEPTH && rec.mat_ptr->scatter(ray, rec, attenuation, ray_out))
-		{
-			return emitted + attenuation * ray_trace(ray_out, world, depth + 1);
-		}
-		else
-			return emitted;
-	}
-	else
-		return AMBIENT_LIGHT;
-}
-
-
 void setupCornellWalls(Hitable** list, int& i)
 {
 	//left walls
@@ -286,9 +519,6 @@ Hitable* cornell_box()
 	Hitable** list = new Hitable*[11];
 	int i = 0;
 
-	g_lights.emplace_back(Vector3((150 + 400) / 2, 524, (150 + 400) / 2), Vector3(400 - 150, 0, 400 - 150), Vector3(1),
-	                      Vector3(300));
-
 	setupCornellWalls(list, i);
 	//list[i++] = new XZRect(150, 400, 150, 400, 554.9, light);
 	list[i++] = new XZRect(0, 555, 0, 555, 554, light2);